@@ -0,0 +1,11 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+void _bounds_error(char *file, int line, char *array, int dim,
+                   long long index, long long lower, long long upper)
+{
+  fflush(stdout);
+  fprintf(stderr, "%s:%d: runtime error: index %lld of dimension %d of array '%s' is out of bounds %lld:%lld\n",
+          file, line, index, dim, array, lower, upper);
+  exit(1);
+}
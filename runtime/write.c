@@ -4,6 +4,10 @@ void _write_int(int value)
 {
   printf("%d\n", value);
 }
+void _write_long(long long value)
+{
+  printf("%lld\n", value);
+}
 void _write_float(float value)
 {
   printf("%f\n", value);
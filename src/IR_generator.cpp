@@ -9,8 +9,13 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
+#include <algorithm>
+#include <functional>
 
 // for codeout
 #include "llvm/IR/LegacyPassManager.h"
@@ -19,12 +24,19 @@
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Host.h"
+#include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 
+// for optimization
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+
 using namespace llvm;
 
 static llvm::Module *module;
@@ -33,6 +45,45 @@ static IRBuilder<> builder(context);
 static std::map<std::string, llvm::Value *> variable_table;
 static std::map<std::string, llvm::Value *> procedure_table;
 static std::map<std::string, llvm::Value *> global_string_table;
+static Compile_options options;
+static std::map<std::string, llvm::MDNode *> alias_scope_table;
+static std::map<std::string, llvm::MDNode *> noalias_table;
+static std::map<ast::Type_kind, llvm::MDNode *> tbaa_tag_table;
+static std::vector<llvm::Value *> heap_array_table;
+static bool is_main_program;
+static std::string target_cpu;
+static std::string target_features;
+static llvm::TargetMachine *target_machine;
+static std::string source_name;
+// do-variables of the DO constructs being generated, they are not defined inside their loops
+static std::vector<std::string> active_do_variables;
+// array elements whose bounds are checked in the preheader, one set for each loop being generated.
+// A loop body generated twice gets its own checks in each copy
+static std::vector<std::set<const ast::Array_element_reference *>> hoisted_bounds_checks;
+// values of the array constructors: the read-only global of a constant one, and the
+// temporary of the others, built before the loops of the statement being generated
+static std::map<const ast::Array_constructor *, llvm::Value *> constructor_table;
+// values of the scalar operands of the elementwise expression being generated, evaluated before its loop.
+// An element of the array being defined is read before any element is defined
+static std::map<const ast::Expression *, llvm::Value *> scalar_operand_table;
+// i1 mask of the element of a WHERE being generated, integer divisors are replaced by 1 where it is false
+static llvm::Value *where_mask = nullptr;
+// the llvm::Function of each program unit defined in the file
+static std::map<const ast::Program_unit *, llvm::Function *> function_table;
+// storage of the variables referenced by internal subprograms, made by the host
+static std::map<const ast::Variable *, llvm::Value *> host_storage_table;
+// the block of the program unit being generated that returns, RETURN statements branch to it
+static llvm::BasicBlock *return_block;
+// number of loops around the code being generated
+static int loop_depth = 0;
+// a call of a procedure, small ones called in loops are inlined
+struct Call_site {
+  llvm::CallInst *call;
+  const ast::Program_unit *procedure;
+  int line_num;
+  bool in_loop;
+};
+static std::vector<Call_site> call_sites;
 
 namespace IR_generator {
   void add_library_prototype_to_module() {
@@ -47,6 +98,15 @@ namespace IR_generator {
       arg.setName("value");
     }
 
+    std::vector<llvm::Type*> long_types(1, llvm::Type::getInt64Ty(context));
+    func =
+      llvm::Function::Create(llvm::FunctionType::get(llvm::Type::getInt32Ty(context), long_types, true),
+                             llvm::Function::ExternalLinkage, "_write_long", module);
+    procedure_table["_write_long"] = func;
+    for (auto &arg : func->args()) {
+      arg.setName("value");
+    }
+
     func =
       llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, "_write_float", module);
     procedure_table["_write_float"] = func;
@@ -68,7 +128,631 @@ namespace IR_generator {
       arg.setName("value");
     }
   }
-  void codeout(std::string outfile_name) {
+  // resolve -march= and -mattr= into the CPU name and the feature string
+  void resolve_target() {
+    SubtargetFeatures features;
+    target_cpu = options.cpu;
+    if (target_cpu == "native") {
+      target_cpu = sys::getHostCPUName().str();
+      StringMap<bool> host_features;
+      if (sys::getHostCPUFeatures(host_features)) {
+        for (auto &feature : host_features) {
+          features.AddFeature(feature.first(), feature.second);
+        }
+      }
+    }
+    // explicit -mattr= entries come last so that they override the host ones
+    SubtargetFeatures user_features(options.features);
+    for (const std::string &feature : user_features.getFeatures()) {
+      features.AddFeature(feature);
+    }
+    target_features = features.getString();
+  }
+  // the vectorizer's cost model reads the CPU from the function attributes
+  void set_target_attributes(llvm::Function *func) {
+    func->addFnAttr("target-cpu", target_cpu);
+    if (!target_features.empty()) {
+      func->addFnAttr("target-features", target_features);
+    }
+    // the backend resets the floating-point TargetOptions from these for each function.
+    // unsafe-fp-math also lets it fuse multiply-adds, so it follows -ffp-contract=
+    if (options.fast_math) {
+      if (options.fp_contract == FP_contract::fast) func->addFnAttr("unsafe-fp-math", "true");
+      func->addFnAttr("no-infs-fp-math", "true");
+      func->addFnAttr("no-nans-fp-math", "true");
+    }
+    if (options.no_signed_zeros) {
+      func->addFnAttr("no-signed-zeros-fp-math", "true");
+    }
+  }
+  llvm::FastMathFlags get_fast_math_flags() {
+    llvm::FastMathFlags flags;
+    // setFast() would also allow contraction, which only -ffp-contract= decides
+    if (options.fast_math) {
+      flags.setAllowReassoc();
+      flags.setNoNaNs();
+      flags.setNoInfs();
+      flags.setAllowReciprocal();
+      flags.setApproxFunc();
+    }
+    if (options.no_signed_zeros) flags.setNoSignedZeros();
+    if (options.fp_contract == FP_contract::fast) flags.setAllowContract(true);
+    return flags;
+  }
+  llvm::FPOpFusion::FPOpFusionMode get_fp_op_fusion() {
+    switch (options.fp_contract) {
+    case FP_contract::fast:
+      return llvm::FPOpFusion::Fast;
+    case FP_contract::on:
+      return llvm::FPOpFusion::Standard;
+    default:
+      return llvm::FPOpFusion::Strict;
+    }
+  }
+  // storage of different Fortran types never aliases, each type gets its own TBAA node
+  void create_tbaa_tags() {
+    MDBuilder md_builder(context);
+    llvm::MDNode *root = md_builder.createTBAARoot("Fortran TBAA");
+    auto create_tag = [&](std::string name) {
+      llvm::MDNode *type = md_builder.createTBAAScalarTypeNode(name, root);
+      return md_builder.createTBAAStructTagNode(type, type, 0);
+    };
+    tbaa_tag_table[ast::Type_kind::i32] = create_tag("integer");
+    tbaa_tag_table[ast::Type_kind::i64] = create_tag("integer(8)");
+    tbaa_tag_table[ast::Type_kind::fp32] = create_tag("real");
+    tbaa_tag_table[ast::Type_kind::logical] = create_tag("logical");
+    tbaa_tag_table[ast::Type_kind::character] = create_tag("character");
+  }
+  // distinct Fortran arrays never alias, each array gets its own scope
+  void create_alias_scopes(const std::map<std::string, std::shared_ptr<ast::Variable>> &variables,
+                           std::string unit_name) {
+    alias_scope_table.clear();
+    noalias_table.clear();
+    MDBuilder md_builder(context);
+    llvm::MDNode *domain = md_builder.createAnonymousAliasScopeDomain(unit_name);
+    std::map<std::string, llvm::MDNode *> scopes;
+    for (auto &var : variables) {
+      if (var.second->is_array()) {
+        scopes[var.first] = md_builder.createAnonymousAliasScope(domain, var.first);
+      }
+    }
+    for (auto &scope : scopes) {
+      std::vector<llvm::Metadata *> others;
+      for (auto &other : scopes) {
+        if (other.first != scope.first) {
+          others.push_back(other.second);
+        }
+      }
+      alias_scope_table[scope.first] = llvm::MDNode::get(context, {scope.second});
+      noalias_table[scope.first] = llvm::MDNode::get(context, others);
+    }
+  }
+  // attach TBAA and alias scope metadata to a load or store of the variable
+  llvm::Instruction *set_access_metadata(llvm::Instruction *inst, std::string var_name, ast::Type_kind kind) {
+    if (tbaa_tag_table.count(kind)) {
+      inst->setMetadata(LLVMContext::MD_tbaa, tbaa_tag_table[kind]);
+    }
+    if (alias_scope_table.count(var_name)) {
+      inst->setMetadata(LLVMContext::MD_alias_scope, alias_scope_table[var_name]);
+      inst->setMetadata(LLVMContext::MD_noalias, noalias_table[var_name]);
+    }
+    return inst;
+  }
+  void report(int line_num, std::string message) {
+    if (options.opt_info) {
+      std::cerr << source_name << ":" << line_num << ": optimized: " << message << std::endl;
+    }
+  }
+  // logical values are stored as i32, and characters as i8
+  llvm::Type *get_storage_type(ast::Type_kind kind) {
+    if (kind == ast::Type_kind::logical) return builder.getInt32Ty();
+    return ast::Type(kind).get_llvm_type(builder);
+  }
+  llvm::Function *get_or_create_function(std::string name, llvm::FunctionType *func_type) {
+    llvm::Function *func = module->getFunction(name);
+    if (!func) {
+      func = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, name, module);
+    }
+    return func;
+  }
+  // zero-initialized internal global, placed in .bss
+  llvm::Value *create_static_array(llvm::Type *elm_type, int64_t count, std::string name) {
+    llvm::ArrayType *array_type = llvm::ArrayType::get(elm_type, count);
+    auto *global = new llvm::GlobalVariable(*module, array_type, false,
+                                            llvm::GlobalValue::InternalLinkage,
+                                            llvm::ConstantAggregateZero::get(array_type),
+                                            name);
+    global->setAlignment(options.array_alignment);
+    llvm::Constant *zero = builder.getInt64(0);
+    return llvm::ConstantExpr::getInBoundsGetElementPtr(array_type, global,
+                                                        llvm::ArrayRef<llvm::Constant *>({zero, zero}));
+  }
+  // internal global with the values, placed in .rodata when read_only and in .data otherwise
+  llvm::Value *create_initialized_array(llvm::Type *elm_type, const std::vector<llvm::Constant *> &values,
+                                        bool read_only, std::string name) {
+    llvm::ArrayType *array_type = llvm::ArrayType::get(elm_type, values.size());
+    auto *global = new llvm::GlobalVariable(*module, array_type, read_only,
+                                            read_only ? llvm::GlobalValue::PrivateLinkage : llvm::GlobalValue::InternalLinkage,
+                                            llvm::ConstantArray::get(array_type, values),
+                                            name);
+    global->setAlignment(options.array_alignment);
+    if (read_only) global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    llvm::Constant *zero = builder.getInt64(0);
+    return llvm::ConstantExpr::getInBoundsGetElementPtr(array_type, global,
+                                                        llvm::ArrayRef<llvm::Constant *>({zero, zero}));
+  }
+  // page-aligned storage from aligned_alloc()
+  llvm::CallInst *create_aligned_alloc(llvm::Value *bytes, std::string name) {
+    const uint64_t page_size = std::max<uint64_t>(4096, options.array_alignment);
+    llvm::Type *i8_ptr = builder.getInt8PtrTy();
+    llvm::Function *aligned_alloc =
+      get_or_create_function("aligned_alloc",
+                             llvm::FunctionType::get(i8_ptr, {builder.getInt64Ty(), builder.getInt64Ty()}, false));
+    // the size passed to aligned_alloc must be a multiple of the alignment
+    llvm::Value *rounded = builder.CreateAnd(builder.CreateAdd(bytes, builder.getInt64(page_size - 1)),
+                                             builder.getInt64(~(page_size - 1)));
+    llvm::CallInst *ptr = builder.CreateCall(aligned_alloc, {builder.getInt64(page_size), rounded}, name);
+    ptr->addAttribute(llvm::AttributeList::ReturnIndex, llvm::Attribute::getWithAlignment(context, page_size));
+    return ptr;
+  }
+  void create_free(llvm::Value *ptr) {
+    llvm::Function *free_func =
+      get_or_create_function("free",
+                             llvm::FunctionType::get(builder.getVoidTy(), {builder.getInt8PtrTy()}, false));
+    builder.CreateCall(free_func, {ptr});
+  }
+  // released by free_heap_arrays()
+  llvm::Value *create_heap_array(llvm::Type *elm_type, llvm::Value *bytes, std::string name) {
+    llvm::CallInst *ptr = create_aligned_alloc(bytes, name);
+    heap_array_table.push_back(ptr);
+    return builder.CreateBitCast(ptr, elm_type->getPointerTo());
+  }
+  void free_heap_arrays() {
+    for (llvm::Value *ptr : heap_array_table) {
+      create_free(ptr);
+    }
+    heap_array_table.clear();
+  }
+  // storage for the values of an array expression. Small ones are allocated once in the
+  // entry block, the others on the heap, to be released by free_temporaries()
+  llvm::Value *create_temporary_array(llvm::Type *elm_type, int64_t count, std::string name,
+                                      std::vector<llvm::Value *> &heap_temporaries) {
+    uint64_t bytes = count * (elm_type->getPrimitiveSizeInBits() / 8);
+    if (bytes <= options.stack_arrays_limit) {
+      llvm::Function *func = builder.GetInsertBlock()->getParent();
+      llvm::IRBuilder<> entry_builder(&func->getEntryBlock(), func->getEntryBlock().begin());
+      llvm::AllocaInst *alloca = entry_builder.CreateAlloca(elm_type, builder.getInt64(count), name);
+      alloca->setAlignment(options.array_alignment);
+      return alloca;
+    }
+    llvm::CallInst *ptr = create_aligned_alloc(builder.getInt64(bytes), name);
+    heap_temporaries.push_back(ptr);
+    return builder.CreateBitCast(ptr, elm_type->getPointerTo());
+  }
+  // the element count is only known at run time, unless it is a constant
+  llvm::Value *create_temporary_array(llvm::Type *elm_type, llvm::Value *count, std::string name,
+                                      std::vector<llvm::Value *> &heap_temporaries) {
+    if (auto *constant = llvm::dyn_cast<llvm::ConstantInt>(count)) {
+      return create_temporary_array(elm_type, constant->getSExtValue(), name, heap_temporaries);
+    }
+    llvm::Value *bytes = builder.CreateNUWMul(count, builder.getInt64(elm_type->getPrimitiveSizeInBits() / 8));
+    llvm::CallInst *ptr = create_aligned_alloc(bytes, name);
+    heap_temporaries.push_back(ptr);
+    return builder.CreateBitCast(ptr, elm_type->getPointerTo());
+  }
+  void free_temporaries(std::vector<llvm::Value *> &heap_temporaries) {
+    for (llvm::Value *ptr : heap_temporaries) {
+      create_free(ptr);
+    }
+    heap_temporaries.clear();
+  }
+  // logical values other than comparisons are stored as i32
+  llvm::Value *get_condition(llvm::Value *value) {
+    if (value->getType() == builder.getInt1Ty()) return value;
+    return builder.CreateICmpNE(value, llvm::ConstantInt::get(value->getType(), 0), "cond");
+  }
+  // the llvm.loop metadata for the directives, nullptr if there is nothing to say
+  llvm::MDNode *create_loop_id(const ast::Loop_directives &directives) {
+    std::vector<llvm::Metadata *> properties;
+    auto add_property = [&](std::string name, llvm::Constant *value) {
+      std::vector<llvm::Metadata *> operands = {llvm::MDString::get(context, name)};
+      if (value) operands.push_back(llvm::ConstantAsMetadata::get(value));
+      properties.push_back(llvm::MDNode::get(context, operands));
+    };
+    if (directives.unroll == 0) {
+      add_property("llvm.loop.unroll.enable", nullptr);
+    } else if (directives.unroll == 1) {
+      add_property("llvm.loop.unroll.disable", nullptr);
+    } else if (directives.unroll > 1) {
+      add_property("llvm.loop.unroll.count", builder.getInt32(directives.unroll));
+    }
+    if (directives.novector) {
+      add_property("llvm.loop.vectorize.width", builder.getInt32(1));
+    } else if (directives.vector_always) {
+      add_property("llvm.loop.vectorize.enable", builder.getTrue());
+    }
+    // the parallel_loop_access annotation of ivdep refers to the loop id
+    if (properties.empty() && !directives.ivdep) return nullptr;
+    // a loop id is distinct and its first operand refers to itself
+    properties.insert(properties.begin(), nullptr);
+    llvm::MDNode *loop_id = llvm::MDNode::getDistinct(context, properties);
+    loop_id->replaceOperandWith(0, loop_id);
+    return loop_id;
+  }
+  // mark the array element accesses of the blocks as free of dependences carried by the loop.
+  // They are the loads and stores with an alias scope. The do-variable and the scalars, like
+  // the accumulator of a reduction, are left unmarked, so the loop is parallel only when they
+  // are promoted to registers
+  void set_parallel_loop_access(llvm::iterator_range<llvm::Function::iterator> blocks, llvm::MDNode *loop_id) {
+    for (llvm::BasicBlock &BB : blocks) {
+      for (llvm::Instruction &inst : BB) {
+        if (!llvm::isa<llvm::LoadInst>(inst) && !llvm::isa<llvm::StoreInst>(inst)) continue;
+        if (!inst.getMetadata(LLVMContext::MD_alias_scope)) continue;
+        // accesses in nested loops are parallel for every enclosing ivdep loop
+        std::vector<llvm::Metadata *> loops;
+        if (llvm::MDNode *list = inst.getMetadata(LLVMContext::MD_mem_parallel_loop_access)) {
+          if (list->getOperand(0) == list) {
+            loops.push_back(list); // a single loop id
+          } else {
+            loops.insert(loops.end(), list->op_begin(), list->op_end());
+          }
+        }
+        loops.push_back(loop_id);
+        inst.setMetadata(LLVMContext::MD_mem_parallel_loop_access,
+                         loops.size() == 1 ? loop_id : llvm::MDNode::get(context, loops));
+      }
+    }
+  }
+  // emit a top-tested loop that runs body(iv) for iv = 0, 1, ..., trip_count-1
+  // trip_count must not be negative
+  // loop_id is attached to the latch, and parallel marks the body as free of loop-carried dependences
+  void create_counted_loop(llvm::Value *trip_count, std::function<void(llvm::Value *)> body,
+                           llvm::MDNode *loop_id = nullptr, bool parallel = false) {
+    llvm::Function *func = builder.GetInsertBlock()->getParent();
+
+    llvm::BasicBlock *preheaderBB = builder.GetInsertBlock();
+    llvm::BasicBlock *headerBB = llvm::BasicBlock::Create(context, "loop_header", func);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(context, "loop_body", func);
+    llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(context, "after_loop");
+    builder.CreateBr(headerBB);
+
+    builder.SetInsertPoint(headerBB);
+    llvm::PHINode *iv = builder.CreatePHI(trip_count->getType(), 2, "iv");
+    iv->addIncoming(llvm::ConstantInt::get(trip_count->getType(), 0), preheaderBB);
+    builder.CreateCondBr(builder.CreateICmpSLT(iv, trip_count), bodyBB, afterBB);
+
+    builder.SetInsertPoint(bodyBB);
+    loop_depth++;
+    body(iv);
+    loop_depth--;
+    llvm::Value *next_iv = builder.CreateAdd(iv, llvm::ConstantInt::get(trip_count->getType(), 1),
+                                             "iv_next", true, true);
+    iv->addIncoming(next_iv, builder.GetInsertBlock());
+    llvm::BranchInst *latch = builder.CreateBr(headerBB);
+
+    if (loop_id) {
+      latch->setMetadata(LLVMContext::MD_loop, loop_id);
+      if (parallel) {
+        // the loop blocks are the last ones of the function until afterBB is added
+        set_parallel_loop_access(llvm::make_range(headerBB->getIterator(), func->end()), loop_id);
+      }
+    }
+    func->getBasicBlockList().push_back(afterBB);
+    builder.SetInsertPoint(afterBB);
+  }
+  // run body(offset) for the storage offset of every column of a padded shape
+  void create_column_loop(const ast::Shape &shape, std::function<void(llvm::Value *)> body) {
+    create_counted_loop(builder.getInt64(shape.get_size() / shape.get_size(0)), [&](llvm::Value *column) {
+        body(builder.CreateNUWMul(column, builder.getInt64(shape.get_stride(1)), "column_offset"));
+      });
+  }
+  // run body(index) for the storage index of every logical element of the shape,
+  // the padding of a padded shape is skipped
+  void create_array_loop(const ast::Shape &shape, std::function<void(llvm::Value *)> body) {
+    if (!shape.is_padded()) {
+      create_counted_loop(builder.getInt64(shape.get_size()), body);
+      return;
+    }
+    create_column_loop(shape, [&](llvm::Value *column_offset) {
+        create_counted_loop(builder.getInt64(shape.get_size(0)), [&](llvm::Value *i) {
+            body(builder.CreateNUWAdd(column_offset, i, "elm_index"));
+          });
+      });
+  }
+  // the extent of each dimension of the shape, 0 when it is not positive
+  std::vector<llvm::Value *> get_extents(const ast::Shape &shape) {
+    std::vector<llvm::Value *> extents;
+    for (int i=0; i<shape.get_rank(); i++) {
+      const ast::Expression &lower = shape.get_lower_bound(i);
+      const ast::Expression &upper = shape.get_upper_bound(i);
+      if (lower.is_constant_int() && upper.is_constant_int()) {
+        extents.push_back(builder.getInt64(std::max<int64_t>(shape.get_size(i), 0)));
+        continue;
+      }
+      auto codegen_index = [](const ast::Expression &bound) {
+        llvm::Value *value = bound.codegen();
+        if (value->getType() != builder.getInt64Ty()) {
+          value = builder.CreateSExt(value, builder.getInt64Ty());
+        }
+        return value;
+      };
+      llvm::Value *extent = builder.CreateNSWAdd(builder.CreateNSWSub(codegen_index(upper), codegen_index(lower)),
+                                                 builder.getInt64(1), "extent");
+      llvm::Value *positive = builder.CreateICmpSGT(extent, builder.getInt64(0));
+      extents.push_back(builder.CreateSelect(positive, extent, builder.getInt64(0), "extent"));
+    }
+    return extents;
+  }
+  // run body(position) for every position of an array expression, position[k] = 0, 1, ..., extents[k]-1
+  // the first dimension is the innermost loop
+  void create_position_loop(const std::vector<llvm::Value *> &extents,
+                            std::function<void(const std::vector<llvm::Value *> &)> body) {
+    std::vector<llvm::Value *> position(extents.size());
+    std::function<void(int)> create_loop = [&](int k) {
+      if (k < 0) {
+        body(position);
+        return;
+      }
+      create_counted_loop(extents[k], [&](llvm::Value *iv) {
+          position[k] = iv;
+          create_loop(k - 1);
+        });
+    };
+    create_loop(extents.size() - 1);
+  }
+  // the arguments are passed by reference. Variables, array elements and sections pass their
+  // storage, other values are stored in a temporary of the caller
+  llvm::CallInst *create_procedure_call(const ast::Program_unit &procedure,
+                                        const std::vector<std::unique_ptr<ast::Expression>> &args, int line_num) {
+    std::vector<llvm::Value *> values;
+    for (auto &arg : args) {
+      if (dynamic_cast<const ast::Variable_definition*>(arg.get()) || dynamic_cast<const ast::Array_constructor*>(arg.get())) {
+        values.push_back(arg->codegen());
+        continue;
+      }
+      llvm::Value *value = arg->codegen();
+      if (value->getType() == builder.getInt1Ty()) {
+        // logical results are i1
+        value = builder.CreateZExt(value, builder.getInt32Ty());
+      }
+      llvm::Function *func = builder.GetInsertBlock()->getParent();
+      llvm::IRBuilder<> entry_builder(&func->getEntryBlock(), func->getEntryBlock().begin());
+      llvm::Value *temp = entry_builder.CreateAlloca(value->getType(), nullptr, "arg_tmp");
+      builder.CreateStore(value, temp);
+      values.push_back(temp);
+    }
+    llvm::Function *callee = function_table[&procedure];
+    llvm::FunctionType *func_type;
+    llvm::Value *callee_value = callee;
+    if (callee) {
+      func_type = callee->getFunctionType();
+    } else {
+      // a subroutine of another file, the types of the first call are the ones declared
+      std::vector<llvm::Type *> types;
+      for (llvm::Value *value : values) {
+        types.push_back(value->getType());
+      }
+      func_type = llvm::FunctionType::get(builder.getVoidTy(), types, false);
+      llvm::Function *func = get_or_create_function(procedure.get_name() + "_", func_type);
+      callee_value = func;
+      if (func->getFunctionType() != func_type) {
+        callee_value = builder.CreateBitCast(func, func_type->getPointerTo());
+      }
+    }
+    llvm::CallInst *call = builder.CreateCall(func_type, callee_value, values);
+    call_sites.push_back({call, &procedure, line_num, loop_depth > 0});
+    return call;
+  }
+  // the cost is the number of instructions of the procedure. Calls in loops up to
+  // -finline-limit= are always inlined, the others are left to the inliner
+  void inline_calls_in_loops() {
+    for (auto &site : call_sites) {
+      llvm::Function *callee = function_table[site.procedure];
+      if (!site.in_loop || !callee || callee->isDeclaration()) continue;
+      uint64_t cost = 0;
+      for (llvm::BasicBlock &BB : *callee) {
+        cost += BB.size();
+      }
+      if (cost > options.inline_limit) continue;
+      site.call->addAttribute(llvm::AttributeList::FunctionIndex, llvm::Attribute::AlwaysInline);
+      report(site.line_num, "call to '" + site.procedure->get_name() + "' in a loop inlined, cost " + std::to_string(cost));
+    }
+    call_sites.clear();
+  }
+  llvm::Value *get_string_ptr(std::string str) {
+    if (!global_string_table.count(str)) {
+      global_string_table[str] = builder.CreateGlobalStringPtr(str);
+    }
+    return global_string_table[str];
+  }
+  // the constructors of an array expression are built once, before the elementwise loops read them
+  void codegen_constructors(const ast::Expression &expr) {
+    std::vector<const ast::Array_constructor*> constructors;
+    expr.collect_constructors(constructors);
+    for (auto *constructor : constructors) {
+      llvm::Value *values = constructor->codegen();
+      constructor_table[constructor] = values;
+    }
+  }
+  // the scalar subexpressions of an elementwise expression are evaluated once, before its loop
+  void codegen_scalar_operands(const ast::Expression &expr) {
+    std::vector<const ast::Expression*> operands;
+    expr.collect_scalar_operands(operands);
+    for (auto *operand : operands) {
+      llvm::Value *value = operand->codegen();
+      scalar_operand_table[operand] = value;
+    }
+  }
+  // the element of an operand, the value evaluated before the loop for a scalar one
+  llvm::Value *codegen_operand_element(const ast::Expression &operand, llvm::Value *index) {
+    auto entry = scalar_operand_table.find(&operand);
+    if (entry != scalar_operand_table.end()) return entry->second;
+    return operand.codegen_element(index);
+  }
+  // -fcheck=bounds, call _bounds_error() unless lower <= index <= upper in the dim-th dimension of ref
+  void create_bounds_check(llvm::Value *index, const ast::Variable_reference &ref, int line_num, int dim) {
+    const ast::Shape &shape = ref.get_var_shape();
+    int64_t lower = shape.get_lower_bound(dim).eval_constant_value();
+    int64_t upper = shape.get_upper_bound(dim).eval_constant_value();
+    if (index->getType() != builder.getInt64Ty()) {
+      index = builder.CreateSExt(index, builder.getInt64Ty());
+    }
+    // one unsigned comparison covers both bounds
+    llvm::Value *out_of_bounds = builder.CreateICmpUGT(builder.CreateSub(index, builder.getInt64(lower)),
+                                                       builder.getInt64(upper - lower), "out_of_bounds");
+    llvm::Function *func = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *error_BB = llvm::BasicBlock::Create(context, "bounds_error", func);
+    llvm::BasicBlock *cont_BB = llvm::BasicBlock::Create(context, "bounds_ok", func);
+    builder.CreateCondBr(out_of_bounds, error_BB, cont_BB, llvm::MDBuilder(context).createBranchWeights(1, 1 << 20));
+
+    builder.SetInsertPoint(error_BB);
+    llvm::Type *i8_ptr = builder.getInt8PtrTy();
+    llvm::Type *i32 = builder.getInt32Ty();
+    llvm::Type *i64 = builder.getInt64Ty();
+    llvm::Function *bounds_error =
+      get_or_create_function("_bounds_error",
+                             llvm::FunctionType::get(builder.getVoidTy(), {i8_ptr, i32, i8_ptr, i32, i64, i64, i64}, false));
+    bounds_error->setDoesNotReturn();
+    bounds_error->addFnAttr(llvm::Attribute::Cold);
+    builder.CreateCall(bounds_error, {get_string_ptr(source_name), builder.getInt32(line_num),
+                                      get_string_ptr(ref.get_var_name()), builder.getInt32(dim+1),
+                                      index, builder.getInt64(lower), builder.getInt64(upper)});
+    builder.CreateUnreachable();
+    builder.SetInsertPoint(cont_BB);
+  }
+  void create_bounds_checks(const ast::Array_element_reference &element) {
+    for (auto &checked : hoisted_bounds_checks) {
+      if (checked.count(&element)) return;
+    }
+    for (size_t dim = 0; dim < element.get_indices().size(); dim++) {
+      create_bounds_check(element.get_indices()[dim]->codegen(), element, element.get_line_num(), dim);
+    }
+  }
+  // the first and the last index of each triplet, and the other subscripts, unless the section is empty
+  void create_bounds_checks(const ast::Array_section &section) {
+    std::vector<llvm::Value *> extents = get_extents(section.get_shape());
+    llvm::Value *not_empty = builder.getTrue();
+    for (llvm::Value *extent : extents) {
+      not_empty = builder.CreateAnd(not_empty, builder.CreateICmpSGT(extent, builder.getInt64(0)), "not_empty");
+    }
+    if (not_empty == builder.getFalse()) return;
+    llvm::BasicBlock *cont_BB = nullptr;
+    if (not_empty != builder.getTrue()) {
+      llvm::Function *func = builder.GetInsertBlock()->getParent();
+      llvm::BasicBlock *check_BB = llvm::BasicBlock::Create(context, "section_check", func);
+      cont_BB = llvm::BasicBlock::Create(context, "section_check_end", func);
+      builder.CreateCondBr(not_empty, check_BB, cont_BB);
+      builder.SetInsertPoint(check_BB);
+    }
+    int k = 0;
+    for (int dim=0; dim<section.get_subscripts().size(); dim++) {
+      const ast::Section_subscript &subscript = section.get_subscripts()[dim];
+      llvm::Value *first = subscript.lower->codegen();
+      create_bounds_check(first, section, section.get_line_num(), dim);
+      if (!subscript.upper) continue;
+      llvm::Value *steps = builder.CreateNSWSub(extents[k++], builder.getInt64(1));
+      llvm::Value *last = builder.CreateNSWAdd(first, builder.CreateNSWMul(steps, subscript.stride->codegen()));
+      create_bounds_check(last, section, section.get_line_num(), dim);
+    }
+    if (cont_BB) {
+      builder.CreateBr(cont_BB);
+      builder.SetInsertPoint(cont_BB);
+    }
+  }
+  // the value of an affine form over integer scalars, with var taken to be var_value
+  llvm::Value *create_affine_value(const ast::Affine_form &form, std::string var, llvm::Value *var_value) {
+    llvm::Value *value = builder.getInt64(form.constant);
+    for (auto &term : form.coeffs) {
+      if (term.second == 0) continue;
+      llvm::Value *x = var_value;
+      if (term.first != var) {
+        x = builder.CreateLoad(variable_table[term.first], "var_tmp");
+        if (x->getType() != builder.getInt64Ty()) {
+          x = builder.CreateSExt(x, builder.getInt64Ty());
+        }
+      }
+      value = builder.CreateAdd(value, builder.CreateMul(x, builder.getInt64(term.second)));
+    }
+    return value;
+  }
+  // iterations ahead a prefetch has to be issued to hide the memory latency,
+  // every instruction of the body emitted from body_begin on is taken to cost a cycle
+  int64_t get_prefetch_distance(llvm::BasicBlock *body_begin) {
+    uint64_t cost = 0;
+    for (llvm::BasicBlock &BB : llvm::make_range(body_begin->getIterator(), body_begin->getParent()->end())) {
+      cost += BB.size();
+    }
+    cost = std::max<uint64_t>(cost, 1);
+    return std::max<uint64_t>((options.prefetch_latency + cost - 1) / cost, 1);
+  }
+  // prefetch the element the stream reaches distance iterations later
+  void create_prefetch(const ast::Prefetch_stream &stream, int64_t distance) {
+    llvm::Value *offset = stream.ref->get_offset_expr().codegen();
+    offset = builder.CreateAdd(offset, builder.getInt64(stream.step * distance), "prefetch_offset");
+    // not inbounds, the stream may run past the array and a prefetch does not fault
+    llvm::Value *ptr = builder.CreateGEP(variable_table[stream.ref->get_var_name()], offset, "prefetch_ptr");
+    llvm::Function *prefetch = llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::prefetch);
+    // rw, locality 3 keeps the line in every cache level, and 1 is the data cache
+    builder.CreateCall(prefetch, {builder.CreateBitCast(ptr, builder.getInt8PtrTy()),
+                                  builder.getInt32(stream.is_write), builder.getInt32(3), builder.getInt32(1)});
+  }
+  // if every byte of the constant c is the same, return that byte
+  llvm::Value *get_splat_byte(llvm::Value *c) {
+    llvm::APInt bits;
+    if (auto *int_constant = llvm::dyn_cast<llvm::ConstantInt>(c)) {
+      bits = int_constant->getValue();
+    } else if (auto *fp_constant = llvm::dyn_cast<llvm::ConstantFP>(c)) {
+      bits = fp_constant->getValueAPF().bitcastToAPInt();
+    } else {
+      return nullptr;
+    }
+    if (bits.getBitWidth() % 8 != 0 || !bits.isSplat(8)) return nullptr;
+    return builder.getInt8(bits.trunc(8).getZExtValue());
+  }
+  CodeGenOpt::Level get_codegen_opt_level(int opt_level) {
+    switch (opt_level) {
+    case 0:
+      return CodeGenOpt::None;
+    case 1:
+      return CodeGenOpt::Less;
+    case 2:
+      return CodeGenOpt::Default;
+    default:
+      return CodeGenOpt::Aggressive;
+    }
+  }
+  // run the same module and function pipeline as clang -O<n>
+  // (SROA/mem2reg, instcombine, GVN, LICM, loop and SLP vectorizers, ...)
+  void optimize(TargetMachine *target_machine) {
+    if (options.opt_level == 0) return;
+
+    PassManagerBuilder pass_builder;
+    pass_builder.OptLevel = options.opt_level;
+    pass_builder.SizeLevel = 0;
+    pass_builder.Inliner = createFunctionInliningPass(options.opt_level, 0, false);
+    pass_builder.LoopVectorize = options.opt_level >= 2;
+    pass_builder.SLPVectorize = options.opt_level >= 2;
+    target_machine->adjustPassManager(pass_builder);
+
+    legacy::FunctionPassManager function_passes(module);
+    legacy::PassManager module_passes;
+    TargetLibraryInfoImpl library_info(Triple(module->getTargetTriple()));
+    module_passes.add(new TargetLibraryInfoWrapperPass(library_info));
+    // cost models of the vectorizers need to know the target
+    module_passes.add(createTargetTransformInfoWrapperPass(target_machine->getTargetIRAnalysis()));
+    function_passes.add(createTargetTransformInfoWrapperPass(target_machine->getTargetIRAnalysis()));
+    pass_builder.populateFunctionPassManager(function_passes);
+    pass_builder.populateModulePassManager(module_passes);
+
+    function_passes.doInitialization();
+    for (llvm::Function &func : *module) {
+      function_passes.run(func);
+    }
+    function_passes.doFinalization();
+    module_passes.run(*module);
+  }
+  // the data layout is fixed before codegen so that type sizes and alignments are known
+  bool create_target_machine() {
     // Initialize the target registry etc.
     llvm::InitializeAllTargetInfos();
     llvm::InitializeAllTargets();
@@ -86,18 +770,54 @@ namespace IR_generator {
     // TargetRegistry or we have a bogus target triple.
     if (!Target) {
       errs() << Error;
-      return;
+      return false;
     }
 
-    auto CPU = "generic";
-    auto Features = "";
+    auto CPU = target_cpu;
+    auto Features = target_features;
 
     TargetOptions opt;
+    opt.UnsafeFPMath = options.fast_math && options.fp_contract == FP_contract::fast;
+    opt.NoInfsFPMath = options.fast_math;
+    opt.NoNaNsFPMath = options.fast_math;
+    opt.NoSignedZerosFPMath = options.no_signed_zeros;
+    opt.AllowFPOpFusion = get_fp_op_fusion();
     auto RM = Optional<Reloc::Model>();
-    auto TheTargetMachine =
-      Target->createTargetMachine(TargetTriple, CPU, Features, opt, RM);
+    target_machine =
+      Target->createTargetMachine(TargetTriple, CPU, Features, opt, RM, None,
+                                  get_codegen_opt_level(options.opt_level));
 
-    module->setDataLayout(TheTargetMachine->createDataLayout());
+    module->setDataLayout(target_machine->createDataLayout());
+    return true;
+  }
+  // alignment of an element access: the alignment of the base storage, reduced by
+  // the offset when it is constant and by the element size otherwise. Dummy arguments
+  // have no alignment attribute, they may be associated with any element of an array.
+  // ValueTracking can't be used here, the loop PHIs are still incomplete.
+  unsigned get_known_alignment(llvm::Value *ptr) {
+    const llvm::DataLayout &layout = module->getDataLayout();
+    llvm::Type *elm_type = ptr->getType()->getPointerElementType();
+    unsigned natural = layout.getABITypeAlignment(elm_type);
+    auto *gep = llvm::dyn_cast<llvm::GEPOperator>(ptr);
+    if (!gep) {
+      unsigned alignment = ptr->stripPointerCasts()->getPointerAlignment(layout);
+      return std::max(natural, alignment);
+    }
+    unsigned base_alignment = gep->getPointerOperand()->stripPointerCasts()->getPointerAlignment(layout);
+    if (base_alignment <= natural) {
+      return natural;
+    }
+    llvm::APInt offset(layout.getPointerTypeSizeInBits(gep->getType()), 0);
+    if (gep->accumulateConstantOffset(layout, offset)) {
+      return llvm::MinAlign(base_alignment, offset.getZExtValue());
+    }
+    return std::max(natural, (unsigned)llvm::MinAlign(base_alignment, layout.getTypeAllocSize(elm_type)));
+  }
+  void codeout(std::string outfile_name) {
+    if (!target_machine) {
+      return;
+    }
+    optimize(target_machine);
 
     std::error_code EC;
     raw_fd_ostream dest(outfile_name, EC, sys::fs::F_None);
@@ -110,7 +830,7 @@ namespace IR_generator {
     legacy::PassManager pass;
     auto FileType = TargetMachine::CGFT_ObjectFile;
 
-    if (TheTargetMachine->addPassesToEmitFile(pass, dest, FileType)) {
+    if (target_machine->addPassesToEmitFile(pass, dest, FileType)) {
       errs() << "TheTargetMachine can't emit a file of this type";
       return;
     }
@@ -119,10 +839,26 @@ namespace IR_generator {
     dest.flush();
   }
   
-  void generate_IR(const std::shared_ptr<ast::Program_unit> program, bool debug_mode) {
+  void generate_IR(const std::shared_ptr<ast::Program_unit> program, const Compile_options &opts,
+                   std::string source_name, bool debug_mode) {
+    options = opts;
+    ::source_name = source_name;
+    resolve_target();
     module = new llvm::Module("top", context);
+    constructor_table.clear();
+    function_table.clear();
+    host_storage_table.clear();
+    create_target_machine();
+    create_tbaa_tags();
+    // every floating-point operation the builder creates gets these
+    builder.setFastMathFlags(get_fast_math_flags());
     add_library_prototype_to_module();
+    program->declare();
     program->codegen();
+    if (options.opt_level >= 2) {
+      inline_calls_in_loops();
+    }
+    call_sites.clear();
     if (debug_mode) {
       std::cout << "=== LLVM IR ===" << std::endl;
       module->print(llvm::errs(), nullptr);
@@ -134,6 +870,9 @@ namespace ast {
   llvm::Value *Int32_constant::codegen() const {
     return llvm::ConstantInt::get(llvm::Type::getInt32Ty(context), this->value);
   }
+  llvm::Value *Int64_constant::codegen() const {
+    return llvm::ConstantInt::get(llvm::Type::getInt64Ty(context), this->value);
+  }
   llvm::Value *FP32_constant::codegen() const {
     return llvm::ConstantFP::get(llvm::Type::getFloatTy(context), this->value);
   }
@@ -143,6 +882,39 @@ namespace ast {
   llvm::Value *Character_constant::codegen() const {
     return global_string_table[this->value];
   }
+  // a constant constructor is a read-only global, made once, the others are built in a temporary
+  llvm::Value *Array_constructor::codegen() const {
+    llvm::Type *elm_type = IR_generator::get_storage_type(this->get_type_kind());
+    if (this->is_constant()) {
+      auto entry = constructor_table.find(this);
+      if (entry != constructor_table.end()) return entry->second;
+      std::vector<llvm::Constant *> values;
+      for (auto &element : this->elements) {
+        values.push_back(llvm::cast<llvm::Constant>(element->codegen()));
+      }
+      llvm::Value *global = IR_generator::create_initialized_array(elm_type, values, true, "constructor");
+      constructor_table[this] = global;
+      return global;
+    }
+    llvm::Function *func = builder.GetInsertBlock()->getParent();
+    llvm::IRBuilder<> entry_builder(&func->getEntryBlock(), func->getEntryBlock().begin());
+    llvm::Value *temp = entry_builder.CreateAlloca(elm_type, builder.getInt64(this->elements.size()), "constructor_tmp");
+    for (int i=0; i<this->elements.size(); i++) {
+      llvm::Value *value = this->elements[i]->codegen();
+      if (value->getType() != elm_type) {
+        // logical results are i1
+        value = builder.CreateZExt(value, elm_type);
+      }
+      builder.CreateStore(value, builder.CreateInBoundsGEP(temp, builder.getInt64(i), "constructor_elm"));
+    }
+    return temp;
+  }
+  llvm::Value *Array_constructor::codegen_element(llvm::Value *index) const {
+    auto entry = constructor_table.find(this);
+    llvm::Value *values = entry != constructor_table.end() ? entry->second : this->codegen();
+    llvm::Value *ptr = builder.CreateInBoundsGEP(values, index, "constructor_ptr");
+    return builder.CreateLoad(ptr, "constructor_load");
+  }
   llvm::Value *Variable_reference::codegen() const {
     if (this->get_type_kind() == Type_kind::character) {
       llvm::Value* zero = builder.getInt32(0);
@@ -157,63 +929,208 @@ namespace ast {
                                         zero,
                                         "array_ref");
     } else {
-      return builder.CreateLoad(variable_table[this->var->get_name()], "var_tmp");
+      llvm::LoadInst *load = builder.CreateLoad(variable_table[this->var->get_name()], "var_tmp");
+      IR_generator::set_access_metadata(load, this->get_var_name(), this->get_type_kind());
+      return load;
     }
   }
+  llvm::Value *Variable_reference::codegen_element(llvm::Value *index) const {
+    if (!this->is_array()) {
+      return this->codegen();
+    }
+    llvm::Value *ptr = builder.CreateInBoundsGEP(variable_table[this->get_var_name()], index, "elm_ptr");
+    llvm::LoadInst *load = builder.CreateAlignedLoad(ptr, IR_generator::get_known_alignment(ptr), "elm_load_tmp");
+    IR_generator::set_access_metadata(load, this->get_var_name(), this->get_type_kind());
+    return load;
+  }
+  llvm::Value *Variable_reference::codegen_at(const std::vector<llvm::Value *> &position) const {
+    if (!this->is_array()) {
+      return this->codegen();
+    }
+    llvm::Value *ptr = this->codegen_ptr_at(position);
+    llvm::LoadInst *load = builder.CreateAlignedLoad(ptr, IR_generator::get_known_alignment(ptr), "elm_load_tmp");
+    IR_generator::set_access_metadata(load, this->get_var_name(), this->get_type_kind());
+    return load;
+  }
+  llvm::Value *Variable_reference::codegen_ptr_at(const std::vector<llvm::Value *> &position) const {
+    const Shape &shape = this->get_shape();
+    llvm::Value *offset = position[0];
+    for (int k=1; k<position.size(); k++) {
+      offset = builder.CreateNSWAdd(offset, builder.CreateNSWMul(position[k], builder.getInt64(shape.get_stride(k))));
+    }
+    return builder.CreateInBoundsGEP(variable_table[this->get_var_name()], offset, "elm_ptr");
+  }
+  // the storage offset of the element, the subscripts are index_type_kind
+  llvm::Value *Array_section::codegen_offset(const std::vector<llvm::Value *> &position) const {
+    const Shape &shape = this->var->get_shape();
+    llvm::Value *offset = builder.getInt64(-shape.get_base_offset());
+    int k = 0;
+    for (int i=0; i<this->subscripts.size(); i++) {
+      const Section_subscript &subscript = this->subscripts[i];
+      llvm::Value *index = subscript.lower->codegen();
+      if (subscript.upper) {
+        index = builder.CreateNSWAdd(index, builder.CreateNSWMul(position[k++], subscript.stride->codegen()),
+                                     "section_index");
+      }
+      offset = builder.CreateNSWAdd(offset, builder.CreateNSWMul(index, builder.getInt64(shape.get_stride(i))));
+    }
+    return offset;
+  }
+  llvm::Value *Array_section::codegen_ptr_at(const std::vector<llvm::Value *> &position) const {
+    return builder.CreateInBoundsGEP(variable_table[this->get_var_name()], this->codegen_offset(position),
+                                     "section_ptr");
+  }
+  llvm::Value *Array_section::codegen() const {
+    return this->codegen_ptr_at(std::vector<llvm::Value *>(this->shape->get_rank(), builder.getInt64(0)));
+  }
   llvm::Value *Array_element_reference::codegen() const {
-    llvm::Value *val = builder.CreateGEP(variable_table[this->get_var_name()],
-                                         this->offset_expr->codegen(),
-                                         "array_element_ref");
-    return builder.CreateLoad(val, "elm_load_tmp");
+    if (options.check_bounds) IR_generator::create_bounds_checks(*this);
+    llvm::Value *val = builder.CreateInBoundsGEP(variable_table[this->get_var_name()],
+                                                 this->offset_expr->codegen(),
+                                                 "array_element_ref");
+    llvm::LoadInst *load = builder.CreateAlignedLoad(val, IR_generator::get_known_alignment(val), "elm_load_tmp");
+    IR_generator::set_access_metadata(load, this->get_var_name(), this->get_type_kind());
+    return load;
   }
   llvm::Value *Unary_op::codegen() const {
+    if (this->is_constant_int()) {
+      return llvm::ConstantInt::get(Type(this->get_type_kind()).get_llvm_type(builder),
+                                    this->eval_constant_value(), true);
+    }
+    return this->codegen_op(this->operand->codegen());
+  }
+  llvm::Value *Unary_op::codegen_element(llvm::Value *index) const {
+    if (!this->is_array()) {
+      return this->codegen();
+    }
+    return this->codegen_op(IR_generator::codegen_operand_element(*this->operand, index));
+  }
+  llvm::Value *Unary_op::codegen_at(const std::vector<llvm::Value *> &position) const {
+    if (!this->is_array()) {
+      return this->codegen();
+    }
+    return this->codegen_op(this->operand->codegen_at(position));
+  }
+  llvm::Value *Unary_op::codegen_op(llvm::Value *operand) const {
     switch (this->exp_operator) {
     case unary_op_kind::i32tofp32:
-      return builder.CreateSIToFP(this->operand->codegen(), llvm::Type::getFloatTy(context), "i32tofp32cast");
+      return builder.CreateSIToFP(operand, llvm::Type::getFloatTy(context), "i32tofp32cast");
+    case unary_op_kind::i32toi64:
+      return builder.CreateSExt(operand, llvm::Type::getInt64Ty(context), "i32toi64cast");
+    case unary_op_kind::i64toi32:
+      return builder.CreateTrunc(operand, llvm::Type::getInt32Ty(context), "i64toi32cast");
+    case unary_op_kind::i64tofp32:
+      return builder.CreateSIToFP(operand, llvm::Type::getFloatTy(context), "i64tofp32cast");
     }
     return nullptr;
   }
   llvm::Value *Binary_op::codegen() const {
     if (this->is_constant_int()) {
-      return builder.getInt32(this->eval_constant_value());
+      return llvm::ConstantInt::get(Type(this->get_type_kind()).get_llvm_type(builder),
+                                    this->eval_constant_value(), true);
     }
-    llvm::Value *lhs = this->lhs->codegen();
-    llvm::Value *rhs = this->rhs->codegen();
+    if (options.fp_contract == FP_contract::on) {
+      auto gen = [](const Expression &expr) {return expr.codegen();};
+      if (llvm::Value *value = this->codegen_fmuladd(gen)) return value;
+    }
+    return this->codegen_op(this->lhs->codegen(), this->rhs->codegen());
+  }
+  llvm::Value *Binary_op::codegen_element(llvm::Value *index) const {
+    if (!this->is_array()) {
+      return this->codegen();
+    }
+    if (options.fp_contract == FP_contract::on) {
+      auto gen = [&](const Expression &expr) {return IR_generator::codegen_operand_element(expr, index);};
+      if (llvm::Value *value = this->codegen_fmuladd(gen)) return value;
+    }
+    return this->codegen_op(IR_generator::codegen_operand_element(*this->lhs, index),
+                            IR_generator::codegen_operand_element(*this->rhs, index));
+  }
+  llvm::Value *Binary_op::codegen_at(const std::vector<llvm::Value *> &position) const {
+    if (!this->is_array()) {
+      return this->codegen();
+    }
+    if (options.fp_contract == FP_contract::on) {
+      auto gen = [&](const Expression &expr) {return expr.codegen_at(position);};
+      if (llvm::Value *value = this->codegen_fmuladd(gen)) return value;
+    }
+    return this->codegen_op(this->lhs->codegen_at(position), this->rhs->codegen_at(position));
+  }
+  // -ffp-contract=on: a*b+c, a*b-c and c-a*b of one expression become llvm.fmuladd,
+  // which the backend fuses where the target has FMA. nullptr for other operations
+  llvm::Value *Binary_op::codegen_fmuladd(const std::function<llvm::Value *(const Expression &)> &gen) const {
+    if (this->get_type_kind() != Type_kind::fp32 ||
+        (this->exp_operator != binary_op_kind::add && this->exp_operator != binary_op_kind::sub)) {
+      return nullptr;
+    }
+    auto get_fmul = [](const Expression &expr) -> const Binary_op* {
+      auto *op = dynamic_cast<const Binary_op*>(&expr);
+      return op && op->exp_operator == binary_op_kind::mul && op->get_type_kind() == Type_kind::fp32 ? op : nullptr;
+    };
+    const Binary_op *mul;
+    llvm::Value *addend;
+    bool negate_product = false;
+    if ((mul = get_fmul(*this->lhs))) {
+      addend = gen(*this->rhs);
+      if (this->exp_operator == binary_op_kind::sub) addend = builder.CreateFNeg(addend);
+    } else if ((mul = get_fmul(*this->rhs))) {
+      addend = gen(*this->lhs);
+      negate_product = this->exp_operator == binary_op_kind::sub;
+    } else {
+      return nullptr;
+    }
+    // a scalar product of an elementwise expression is evaluated once, before the loop
+    if (scalar_operand_table.count(mul)) return nullptr;
+    llvm::Value *a = gen(*mul->lhs);
+    llvm::Value *b = gen(*mul->rhs);
+    if (negate_product) a = builder.CreateFNeg(a);
+    llvm::Function *fmuladd = llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::fmuladd, {builder.getFloatTy()});
+    return builder.CreateCall(fmuladd, {a, b, addend}, "fmuladd_tmp");
+  }
+  // integer overflow is not allowed in Fortran, so integer arithmetic is nsw
+  llvm::Value *Binary_op::codegen_op(llvm::Value *lhs, llvm::Value *rhs) const {
     switch (this->exp_operator) {
     case binary_op_kind::add:
-      if (this->get_type_kind() == Type_kind::i32) {
-        return builder.CreateAdd(lhs, rhs, "add_tmp");
+      if (is_integer_kind(this->get_type_kind())) {
+        return builder.CreateNSWAdd(lhs, rhs, "add_tmp");
       } else if (this->get_type_kind() == Type_kind::fp32) {
         return builder.CreateFAdd(lhs, rhs, "fadd_tmp");
       } else {
         assert(0);
       }
     case binary_op_kind::sub:
-      if (this->get_type_kind() == Type_kind::i32) {
-        return builder.CreateSub(lhs, rhs, "sub_tmp");
+      if (is_integer_kind(this->get_type_kind())) {
+        return builder.CreateNSWSub(lhs, rhs, "sub_tmp");
       } else if (this->get_type_kind() == Type_kind::fp32) {
         return builder.CreateFSub(lhs, rhs, "fsub_tmp");
       } else {
         assert(0);
       }
     case binary_op_kind::mul:
-      if (this->get_type_kind() == Type_kind::i32) {
-        return builder.CreateMul(lhs, rhs, "mul_tmp");
+      if (is_integer_kind(this->get_type_kind())) {
+        return builder.CreateNSWMul(lhs, rhs, "mul_tmp");
       } else if (this->get_type_kind() == Type_kind::fp32) {
         return builder.CreateFMul(lhs, rhs, "fmul_tmp");
       } else {
         assert(0);
       }
     case binary_op_kind::div:
-      if (this->get_type_kind() == Type_kind::i32) {
+      if (is_integer_kind(this->get_type_kind())) {
+        if (where_mask) {
+          // the masked-out elements must not trap
+          rhs = builder.CreateSelect(where_mask, rhs, llvm::ConstantInt::get(rhs->getType(), 1), "masked_divisor");
+        }
         return builder.CreateSDiv(lhs, rhs, "div_tmp");
       } else if (this->get_type_kind() == Type_kind::fp32) {
         return builder.CreateFDiv(lhs, rhs, "fdiv_tmp");
       } else {
         assert(0);
       }
+    case binary_op_kind::min:
+      assert(is_integer_kind(this->get_type_kind()));
+      return builder.CreateSelect(builder.CreateICmpSLT(lhs, rhs), lhs, rhs, "min_tmp");
     case binary_op_kind::eq:
-      if (this->lhs->get_type_kind() == Type_kind::i32) {
+      if (is_integer_kind(this->lhs->get_type_kind())) {
         return builder.CreateICmpEQ(lhs, rhs, "ieq_tmp");
       } else if (this->lhs->get_type_kind() == Type_kind::fp32) {
         return builder.CreateFCmpUEQ(lhs, rhs, "feq_tmp");
@@ -221,7 +1138,7 @@ namespace ast {
         assert(0);
       }
     case binary_op_kind::ne:
-      if (this->lhs->get_type_kind() == Type_kind::i32) {
+      if (is_integer_kind(this->lhs->get_type_kind())) {
         return builder.CreateICmpNE(lhs, rhs, "ine_tmp");
       } else if (this->lhs->get_type_kind() == Type_kind::fp32) {
         return builder.CreateFCmpUNE(lhs, rhs, "fne_tmp");
@@ -229,7 +1146,7 @@ namespace ast {
         assert(0);
       }
     case binary_op_kind::lt:
-      if (this->lhs->get_type_kind() == Type_kind::i32) {
+      if (is_integer_kind(this->lhs->get_type_kind())) {
         return builder.CreateICmpSLT(lhs, rhs, "ilt_tmp");
       } else if (this->lhs->get_type_kind() == Type_kind::fp32) {
         return builder.CreateFCmpULT(lhs, rhs, "flt_tmp");
@@ -237,7 +1154,7 @@ namespace ast {
         assert(0);
       }
     case binary_op_kind::le:
-      if (this->lhs->get_type_kind() == Type_kind::i32) {
+      if (is_integer_kind(this->lhs->get_type_kind())) {
         return builder.CreateICmpSLE(lhs, rhs, "ile_tmp");
       } else if (this->lhs->get_type_kind() == Type_kind::fp32) {
         return builder.CreateFCmpULE(lhs, rhs, "fle_tmp");
@@ -245,7 +1162,7 @@ namespace ast {
         assert(0);
       }
     case binary_op_kind::gt:
-      if (this->lhs->get_type_kind() == Type_kind::i32) {
+      if (is_integer_kind(this->lhs->get_type_kind())) {
         return builder.CreateICmpSGT(lhs, rhs, "igt_tmp");
       } else if (this->lhs->get_type_kind() == Type_kind::fp32) {
         return builder.CreateFCmpUGT(lhs, rhs, "fgt_tmp");
@@ -253,7 +1170,7 @@ namespace ast {
         assert(0);
       }
     case binary_op_kind::ge:
-      if (this->lhs->get_type_kind() == Type_kind::i32) {
+      if (is_integer_kind(this->lhs->get_type_kind())) {
         return builder.CreateICmpSGE(lhs, rhs, "ige_tmp");
       } else if (this->lhs->get_type_kind() == Type_kind::fp32) {
         return builder.CreateFCmpUGE(lhs, rhs, "fge_tmp");
@@ -268,14 +1185,46 @@ namespace ast {
   }
 
   llvm::Value *Array_element_definition::codegen() const {
-    return builder.CreateGEP(variable_table[this->get_var_name()],
-                             this->offset_expr->codegen(),
-                             "array_element_def");
+    if (options.check_bounds) IR_generator::create_bounds_checks(*this);
+    return builder.CreateInBoundsGEP(variable_table[this->get_var_name()],
+                                     this->offset_expr->codegen(),
+                                     "array_element_def");
   }
 
   void Assignment_statement::codegen() const
   {
+    if (this->lhs->has_section() || this->rhs->has_section()) {
+      this->codegen_section();
+      return;
+    }
     llvm::Value *lhs = this->lhs->codegen();
+
+    if (this->lhs->is_array() && this->rhs->is_array() &&
+        !dynamic_cast<const Variable_reference*>(this->rhs.get()) &&
+        !dynamic_cast<const Array_constructor*>(this->rhs.get())) {
+      // elementwise expression: one fused loop over the contiguous storage.
+      // every array operand is read at the same flat index and the result is
+      // stored straight into lhs. Whole-array operands overlap lhs only at the
+      // element being defined, and the scalar operands, elements of lhs among them,
+      // are evaluated before the loop, so no temporary is needed.
+      // conformable arrays have the same padding, so they share the storage index too
+      llvm::Type *elm_type = lhs->getType()->getPointerElementType();
+      IR_generator::codegen_constructors(*this->rhs);
+      IR_generator::codegen_scalar_operands(*this->rhs);
+      IR_generator::create_array_loop(this->lhs->get_shape(), [&](llvm::Value *iv) {
+          llvm::Value *value = this->rhs->codegen_element(iv);
+          if (value->getType() != elm_type) {
+            // logical results are i1
+            value = builder.CreateZExt(value, elm_type);
+          }
+          llvm::Value *ptr = builder.CreateInBoundsGEP(lhs, iv, "elm_def");
+          llvm::StoreInst *store = builder.CreateAlignedStore(value, ptr, IR_generator::get_known_alignment(ptr));
+          IR_generator::set_access_metadata(store, this->lhs->get_var_name(), this->lhs->get_type_kind());
+        });
+      scalar_operand_table.clear();
+      return;
+    }
+
     llvm::Value *rhs = this->rhs->codegen();
 
     // TODO: array of character case
@@ -283,16 +1232,327 @@ namespace ast {
       llvm::Value *size = builder.getInt32(this->lhs->get_len().eval_constant_value()+1);
       builder.CreateMemCpy(lhs, rhs, size, /* alignment= */ 1);
     } else if (this->lhs->is_array() && this->rhs->is_array()) {
-      llvm::Value *size = builder.getInt32(this->lhs->get_shape().get_size()*4);
-      builder.CreateMemCpy(lhs, rhs, size, /* alignment= */ 4);
+      const Shape &shape = this->lhs->get_shape();
+      uint64_t elm_size = lhs->getType()->getPointerElementType()->getPrimitiveSizeInBits() / 8;
+      // either side may be a dummy argument associated with an element in the middle of an array
+      unsigned base_alignment = std::min(IR_generator::get_known_alignment(lhs), IR_generator::get_known_alignment(rhs));
+      if (shape.is_padded()) {
+        // only the logical elements are copied, column by column
+        unsigned alignment = llvm::MinAlign(base_alignment, shape.get_stride(1) * elm_size);
+        llvm::Value *size = builder.getInt64(shape.get_size(0) * elm_size);
+        IR_generator::create_column_loop(shape, [&](llvm::Value *offset) {
+            builder.CreateMemCpy(builder.CreateInBoundsGEP(lhs, offset, "column_def"),
+                                 builder.CreateInBoundsGEP(rhs, offset, "column_ref"), size, alignment);
+          });
+      } else {
+        llvm::Value *size = builder.getInt64(shape.get_size() * elm_size);
+        builder.CreateMemCpy(lhs, rhs, size, base_alignment);
+      }
     } else if (this->lhs->is_array() && !this->rhs->is_array()) {
-      /* TODO: create loop that copies rhs scalar for each element in lhs */
-      assert(false);
+      // every element of the contiguous storage gets the same value, whatever the rank is
+      const Shape &shape = this->lhs->get_shape();
+      llvm::Type *elm_type = lhs->getType()->getPointerElementType();
+      llvm::Value *byte = IR_generator::get_splat_byte(rhs);
+      if (byte) {
+        uint64_t elm_size = elm_type->getPrimitiveSizeInBits() / 8;
+        if (shape.is_padded()) {
+          unsigned alignment = llvm::MinAlign(IR_generator::get_known_alignment(lhs), shape.get_stride(1) * elm_size);
+          llvm::Value *size = builder.getInt64(shape.get_size(0) * elm_size);
+          IR_generator::create_column_loop(shape, [&](llvm::Value *offset) {
+              builder.CreateMemSet(builder.CreateInBoundsGEP(lhs, offset, "column_def"), byte, size, alignment);
+            });
+        } else {
+          builder.CreateMemSet(lhs, byte, builder.getInt64(shape.get_size() * elm_size),
+                               IR_generator::get_known_alignment(lhs));
+        }
+      } else {
+        IR_generator::create_array_loop(shape, [&](llvm::Value *iv) {
+            llvm::Value *ptr = builder.CreateInBoundsGEP(lhs, iv, "fill_ptr");
+            llvm::StoreInst *store = builder.CreateAlignedStore(rhs, ptr, IR_generator::get_known_alignment(ptr));
+            IR_generator::set_access_metadata(store, this->lhs->get_var_name(), this->lhs->get_type_kind());
+          });
+      }
     } else {
-      builder.CreateStore(rhs, lhs);
+      llvm::StoreInst *store = builder.CreateAlignedStore(rhs, lhs, IR_generator::get_known_alignment(lhs));
+      IR_generator::set_access_metadata(store, this->lhs->get_var_name(), this->lhs->get_type_kind());
     }
   }
 
+  bool Assignment_statement::needs_temporary() const
+  {
+    std::vector<const Variable_reference*> refs;
+    this->rhs->collect_references(refs);
+    Array_view lhs_view;
+    bool has_lhs_view = this->lhs->get_view(lhs_view) && lhs_view.has_constant_base;
+    for (auto *ref : refs) {
+      if (ref->get_var_name() != this->lhs->get_var_name()) continue;
+      if (!has_lhs_view) return true;
+      if (auto *element = dynamic_cast<const Array_element_reference*>(ref)) {
+        // an element outside the storage range defined
+        const Expression &offset = element->get_offset_expr();
+        if (offset.is_constant_int() &&
+            (offset.eval_constant_value() < lhs_view.get_first() || offset.eval_constant_value() > lhs_view.get_last())) {
+          continue;
+        }
+        return true;
+      }
+      Array_view view;
+      if (!ref->get_view(view) || !view.has_constant_base) return true;
+      if (view.get_last() < lhs_view.get_first() || view.get_first() > lhs_view.get_last()) continue;
+      // every element is read before it is defined, or it is read at the same position,
+      // or the elements read are defined at later positions
+      if (view.steps == lhs_view.steps && view.extents == lhs_view.extents &&
+          (view.base == lhs_view.base || (view.base > lhs_view.base && lhs_view.is_ascending()))) {
+        continue;
+      }
+      return true;
+    }
+    return false;
+  }
+
+  // array sections are views of the storage of the array, they are read and written
+  // in place with one loop per dimension. A temporary is made only when the
+  // right-hand side may read an element defined before it
+  void Assignment_statement::codegen_section() const
+  {
+    llvm::Type *elm_type = this->lhs->codegen()->getType()->getPointerElementType();
+    if (options.check_bounds) {
+      std::vector<const Variable_reference*> refs;
+      this->lhs->collect_references(refs);
+      this->rhs->collect_references(refs);
+      for (auto *ref : refs) {
+        if (auto *section = dynamic_cast<const Array_section*>(ref)) {
+          IR_generator::create_bounds_checks(*section);
+        }
+      }
+    }
+    // a scalar right-hand side is evaluated once, before any element is defined
+    llvm::Value *scalar = nullptr;
+    Array_view lhs_view;
+    if (this->lhs->get_view(lhs_view)) {
+      int64_t count = 1;
+      for (int64_t extent : lhs_view.extents) count *= extent;
+      // nothing is defined by an empty section
+      if (count == 0) return;
+      // a contiguous view is copied or filled as one block
+      auto *rhs_ref = dynamic_cast<const Variable_reference*>(this->rhs.get());
+      Array_view rhs_view;
+      if (lhs_view.is_contiguous()) {
+        llvm::Value *size = builder.getInt64(count * (elm_type->getPrimitiveSizeInBits() / 8));
+        llvm::Value *dst = this->lhs->codegen();
+        if (rhs_ref && rhs_ref->get_view(rhs_view) && rhs_view.is_contiguous()) {
+          llvm::Value *src = rhs_ref->codegen();
+          unsigned alignment = std::min(IR_generator::get_known_alignment(dst), IR_generator::get_known_alignment(src));
+          if (rhs_ref->get_var_name() == this->lhs->get_var_name()) {
+            builder.CreateMemMove(dst, src, size, alignment);
+          } else {
+            builder.CreateMemCpy(dst, src, size, alignment);
+          }
+          return;
+        }
+        if (!this->rhs->is_array()) {
+          scalar = this->rhs->codegen();
+          if (llvm::Value *byte = IR_generator::get_splat_byte(scalar)) {
+            builder.CreateMemSet(dst, byte, size, IR_generator::get_known_alignment(dst));
+            return;
+          }
+        }
+      }
+    }
+
+    std::vector<llvm::Value *> extents = IR_generator::get_extents(this->lhs->get_shape());
+    IR_generator::codegen_constructors(*this->rhs);
+    auto store_at = [&](const std::vector<llvm::Value *> &position, llvm::Value *value) {
+      if (value->getType() != elm_type) {
+        // logical results are i1
+        value = builder.CreateZExt(value, elm_type);
+      }
+      llvm::Value *ptr = this->lhs->codegen_ptr_at(position);
+      llvm::StoreInst *store = builder.CreateAlignedStore(value, ptr, IR_generator::get_known_alignment(ptr));
+      IR_generator::set_access_metadata(store, this->lhs->get_var_name(), this->lhs->get_type_kind());
+    };
+    if (!this->rhs->is_array()) {
+      if (!scalar) scalar = this->rhs->codegen();
+      IR_generator::create_position_loop(extents, [&](const std::vector<llvm::Value *> &position) {
+          store_at(position, scalar);
+        });
+      return;
+    }
+    if (!this->needs_temporary()) {
+      IR_generator::create_position_loop(extents, [&](const std::vector<llvm::Value *> &position) {
+          store_at(position, this->rhs->codegen_at(position));
+        });
+      return;
+    }
+    // the right-hand side is evaluated into a temporary before any element is defined
+    std::vector<llvm::Value *> heap_temporaries;
+    llvm::Value *count = builder.getInt64(1);
+    for (llvm::Value *extent : extents) {
+      count = builder.CreateNUWMul(count, extent, "count");
+    }
+    llvm::Value *values = IR_generator::create_temporary_array(elm_type, count, "section_tmp", heap_temporaries);
+    auto get_temporary_ptr = [&](const std::vector<llvm::Value *> &position) {
+      llvm::Value *index = position.back();
+      for (int k=position.size()-2; k>=0; k--) {
+        index = builder.CreateNUWAdd(builder.CreateNUWMul(index, extents[k]), position[k]);
+      }
+      return builder.CreateInBoundsGEP(values, index, "section_tmp_ptr");
+    };
+    IR_generator::create_position_loop(extents, [&](const std::vector<llvm::Value *> &position) {
+        llvm::Value *value = this->rhs->codegen_at(position);
+        if (value->getType() != elm_type) {
+          value = builder.CreateZExt(value, elm_type);
+        }
+        builder.CreateStore(value, get_temporary_ptr(position));
+      });
+    IR_generator::create_position_loop(extents, [&](const std::vector<llvm::Value *> &position) {
+        store_at(position, builder.CreateLoad(get_temporary_ptr(position), "section_value"));
+      });
+    IR_generator::free_temporaries(heap_temporaries);
+  }
+
+  void Assignment_statement::codegen_masked(llvm::Value *mask, llvm::Value *index, llvm::Value *value) const
+  {
+    llvm::Value *lhs = this->lhs->codegen();
+    llvm::Type *elm_type = lhs->getType()->getPointerElementType();
+    if (!value) {
+      where_mask = mask;
+      value = this->rhs->codegen_element(index);
+      where_mask = nullptr;
+    }
+    if (value->getType() != elm_type) {
+      // logical results are i1
+      value = builder.CreateZExt(value, elm_type);
+    }
+    // the element is always stored, so there is no branch in the loop
+    llvm::Value *ptr = builder.CreateInBoundsGEP(lhs, index, "elm_def");
+    llvm::LoadInst *old = builder.CreateAlignedLoad(ptr, IR_generator::get_known_alignment(ptr), "elm_old");
+    IR_generator::set_access_metadata(old, this->lhs->get_var_name(), this->lhs->get_type_kind());
+    llvm::Value *selected = builder.CreateSelect(mask, value, old, "masked_value");
+    llvm::StoreInst *store = builder.CreateAlignedStore(selected, ptr, IR_generator::get_known_alignment(ptr));
+    IR_generator::set_access_metadata(store, this->lhs->get_var_name(), this->lhs->get_type_kind());
+  }
+
+  bool Where_construct::needs_temporaries() const
+  {
+    std::set<std::string> defined;
+    std::vector<const Variable_reference*> refs;
+    for (auto &clause : this->clauses) {
+      if (clause.mask) clause.mask->collect_references(refs);
+      for (auto &assignment : clause.assignments) {
+        defined.insert(assignment->get_lhs().get_var_name());
+        assignment->get_rhs().collect_references(refs);
+      }
+    }
+    for (auto *ref : refs) {
+      if (dynamic_cast<const Array_element_reference*>(ref) && defined.count(ref->get_var_name())) return true;
+    }
+    return false;
+  }
+
+  // one loop for the whole construct. The masks and the right-hand sides of the element
+  // are evaluated before it is defined, and whole-array operands are read only at that
+  // element, so it is the same as evaluating each mask and statement for all the elements
+  void Where_construct::codegen() const
+  {
+    for (auto &clause : this->clauses) {
+      if (clause.mask) IR_generator::codegen_constructors(*clause.mask);
+      for (auto &assignment : clause.assignments) {
+        IR_generator::codegen_constructors(assignment->get_rhs());
+      }
+    }
+    if (this->needs_temporaries()) {
+      this->codegen_with_temporaries();
+      return;
+    }
+    IR_generator::create_array_loop(this->clauses[0].mask->get_shape(), [&](llvm::Value *iv) {
+        // the element is not taken by the previous clauses
+        llvm::Value *remaining = nullptr;
+        for (auto &clause : this->clauses) {
+          llvm::Value *mask = remaining;
+          if (clause.mask) {
+            where_mask = remaining;
+            llvm::Value *value = IR_generator::get_condition(clause.mask->codegen_element(iv));
+            where_mask = nullptr;
+            mask = remaining ? builder.CreateAnd(remaining, value, "where_mask") : value;
+            llvm::Value *not_value = builder.CreateNot(value);
+            remaining = remaining ? builder.CreateAnd(remaining, not_value, "elsewhere_mask") : not_value;
+          }
+          for (auto &assignment : clause.assignments) {
+            assignment->codegen_masked(mask, iv);
+          }
+        }
+      });
+  }
+
+  // each mask and right-hand side is evaluated into a temporary before the elements are defined
+  void Where_construct::codegen_with_temporaries() const
+  {
+    const Shape &shape = this->clauses[0].mask->get_shape();
+    int64_t count = shape.get_storage_size();
+    std::vector<llvm::Value *> heap_temporaries;
+    llvm::Type *flag_type = builder.getInt8Ty();
+    llvm::Value *remaining = IR_generator::create_temporary_array(flag_type, count, "remaining", heap_temporaries);
+    llvm::Value *control = IR_generator::create_temporary_array(flag_type, count, "control", heap_temporaries);
+    auto load_flag = [&](llvm::Value *flags, llvm::Value *iv) {
+      llvm::Value *flag = builder.CreateLoad(builder.CreateInBoundsGEP(flags, iv), "flag");
+      return builder.CreateTrunc(flag, builder.getInt1Ty());
+    };
+    for (int i=0; i<this->clauses.size(); i++) {
+      const Where_clause &clause = this->clauses[i];
+      IR_generator::create_array_loop(shape, [&](llvm::Value *iv) {
+          llvm::Value *rest = i == 0 ? nullptr : load_flag(remaining, iv);
+          llvm::Value *mask = rest;
+          if (clause.mask) {
+            where_mask = rest;
+            llvm::Value *value = IR_generator::get_condition(clause.mask->codegen_element(iv));
+            where_mask = nullptr;
+            mask = rest ? builder.CreateAnd(rest, value, "where_mask") : value;
+            llvm::Value *not_value = builder.CreateNot(value);
+            llvm::Value *new_rest = rest ? builder.CreateAnd(rest, not_value, "elsewhere_mask") : not_value;
+            builder.CreateStore(builder.CreateZExt(new_rest, flag_type), builder.CreateInBoundsGEP(remaining, iv));
+          }
+          builder.CreateStore(builder.CreateZExt(mask, flag_type), builder.CreateInBoundsGEP(control, iv));
+        });
+      for (auto &assignment : clause.assignments) {
+        llvm::Type *elm_type = assignment->get_lhs().codegen()->getType()->getPointerElementType();
+        llvm::Value *values = IR_generator::create_temporary_array(elm_type, count, "where_tmp", heap_temporaries);
+        IR_generator::create_array_loop(shape, [&](llvm::Value *iv) {
+            where_mask = load_flag(control, iv);
+            llvm::Value *value = assignment->get_rhs().codegen_element(iv);
+            where_mask = nullptr;
+            if (value->getType() != elm_type) {
+              value = builder.CreateZExt(value, elm_type);
+            }
+            builder.CreateStore(value, builder.CreateInBoundsGEP(values, iv));
+          });
+        IR_generator::create_array_loop(shape, [&](llvm::Value *iv) {
+            llvm::Value *value = builder.CreateLoad(builder.CreateInBoundsGEP(values, iv), "where_value");
+            assignment->codegen_masked(load_flag(control, iv), iv, value);
+          });
+      }
+    }
+    IR_generator::free_temporaries(heap_temporaries);
+  }
+
+  llvm::Value *Function_reference::codegen() const
+  {
+    return IR_generator::create_procedure_call(*this->function, this->args, this->line_num);
+  }
+
+  void Call_statement::codegen() const
+  {
+    IR_generator::create_procedure_call(*this->subroutine, this->args, this->line_num);
+  }
+
+  void Return_statement::codegen() const
+  {
+    builder.CreateBr(return_block);
+    // the statements after it are unreachable
+    llvm::Function *func = builder.GetInsertBlock()->getParent();
+    builder.SetInsertPoint(llvm::BasicBlock::Create(context, "after_return", func));
+  }
+
   void Output_statement::codegen() const
   {
     for (auto &elm : this->elements) {
@@ -301,6 +1561,8 @@ namespace ast {
       llvm::Function *callee;
       if (elm->get_type_kind() == Type_kind::i32) {
         callee = module->getFunction("_write_int");
+      } else if (elm->get_type_kind() == Type_kind::i64) {
+        callee = module->getFunction("_write_long");
       } else if (elm->get_type_kind() == Type_kind::fp32) {
         callee = module->getFunction("_write_float");
       } else if (elm->get_type_kind() == Type_kind::logical) {
@@ -314,6 +1576,19 @@ namespace ast {
     }
   }
 
+  void Block::collect_unconditional_elements(std::vector<const Array_element_reference*> &elements) const
+  {
+    for (auto &stmt : this->statements) {
+      std::vector<Memory_access> accesses;
+      if (!dynamic_cast<const Assignment_statement*>(stmt.get()) || !stmt->collect_accesses(accesses)) continue;
+      for (auto &access : accesses) {
+        if (auto *element = dynamic_cast<const Array_element_reference*>(access.ref)) {
+          elements.push_back(element);
+        }
+      }
+    }
+  }
+
   void Block::codegen() const
   {
     for (auto &stmt : this->statements) {
@@ -323,7 +1598,7 @@ namespace ast {
 
   void If_construct::codegen() const
   {
-    llvm::Value *cond_val = this->condition_expression->codegen();
+    llvm::Value *cond_val = IR_generator::get_condition(this->condition_expression->codegen());
 
     llvm::Function *func = builder.GetInsertBlock()->getParent();
 
@@ -352,76 +1627,346 @@ namespace ast {
     builder.SetInsertPoint(merge_BB);
   }
 
+  // trip_count iterations of the body, from the start value stored in do_variable.
+  // The bounds of the elements in checked are already checked in the preheader
+  void Do_construct::codegen_loop(llvm::Value *do_variable, llvm::Value *stride, llvm::Value *trip_count,
+                                  const std::set<const Array_element_reference*> &checked) const
+  {
+    std::string name = this->do_variable->get_var_name();
+    Type_kind kind = this->do_variable->get_type_kind();
+    // top-tested, so that zero-trip loops never execute the body
+    IR_generator::create_counted_loop(trip_count, [&](llvm::Value *iv) {
+        llvm::BasicBlock *body_begin = builder.GetInsertBlock();
+        hoisted_bounds_checks.push_back(checked);
+        this->block->codegen();
+        hoisted_bounds_checks.pop_back();
+        if (!this->prefetch_streams.empty()) {
+          int64_t distance = IR_generator::get_prefetch_distance(body_begin);
+          for (auto &stream : this->prefetch_streams) {
+            IR_generator::create_prefetch(stream, distance);
+          }
+        }
+        llvm::LoadInst *value = builder.CreateLoad(do_variable, "do_var");
+        IR_generator::set_access_metadata(value, name, kind);
+        llvm::Value *next_value = builder.CreateNSWAdd(value, stride, "do_var_next");
+        IR_generator::set_access_metadata(builder.CreateStore(next_value, do_variable), name, kind);
+      }, IR_generator::create_loop_id(this->directives), this->directives.ivdep);
+  }
+
+  // the subscripts of the array elements referenced on every iteration that are affine
+  // in the do-variables are checked once, at the first and the last iteration.
+  // Returns the elements checked. Nothing is checked when the body may leave the loop,
+  // the last iteration may never run
+  std::set<const Array_element_reference*>
+  Do_construct::codegen_bounds_checks(llvm::Value *start, llvm::Value *stride, llvm::Value *trip_count) const
+  {
+    std::set<const Array_element_reference*> checked;
+    if (this->block->has_branch_out()) return checked;
+    std::string var = this->do_variable->get_var_name();
+    std::vector<const Array_element_reference*> elements, hoisted;
+    std::vector<std::vector<Affine_form>> forms;
+    this->block->collect_unconditional_elements(elements);
+    for (auto *element : elements) {
+      std::vector<Affine_form> element_forms;
+      bool invariant = true;
+      for (auto &index : element->get_indices()) {
+        Affine_form form;
+        if (!index->get_affine_form(form)) {
+          invariant = false;
+          break;
+        }
+        for (auto &term : form.coeffs) {
+          if (term.second != 0 &&
+              std::find(active_do_variables.begin(), active_do_variables.end(), term.first) == active_do_variables.end()) {
+            invariant = false;
+          }
+        }
+        element_forms.push_back(form);
+      }
+      if (!invariant || checked.count(element)) continue;
+      hoisted.push_back(element);
+      forms.push_back(element_forms);
+    }
+    if (hoisted.empty()) return checked;
+
+    llvm::Function *func = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *check_BB = llvm::BasicBlock::Create(context, "bounds_check", func);
+    llvm::BasicBlock *merge_BB = llvm::BasicBlock::Create(context, "bounds_checked");
+    builder.CreateCondBr(builder.CreateICmpSGT(trip_count, builder.getInt64(0)), check_BB, merge_BB);
+    builder.SetInsertPoint(check_BB);
+    llvm::Value *first = builder.CreateSExt(start, builder.getInt64Ty());
+    llvm::Value *last = builder.CreateAdd(first, builder.CreateMul(builder.CreateSub(trip_count, builder.getInt64(1)),
+                                                                   builder.CreateSExt(stride, builder.getInt64Ty())),
+                                          "last_value");
+    for (size_t i = 0; i < hoisted.size(); i++) {
+      for (size_t dim = 0; dim < forms[i].size(); dim++) {
+        IR_generator::create_bounds_check(IR_generator::create_affine_value(forms[i][dim], var, first), *hoisted[i],
+                                          hoisted[i]->get_line_num(), dim);
+        if (forms[i][dim].coeffs[var] != 0) {
+          IR_generator::create_bounds_check(IR_generator::create_affine_value(forms[i][dim], var, last), *hoisted[i],
+                                            hoisted[i]->get_line_num(), dim);
+        }
+      }
+      checked.insert(hoisted[i]);
+    }
+    builder.CreateBr(merge_BB);
+    func->getBasicBlockList().push_back(merge_BB);
+    builder.SetInsertPoint(merge_BB);
+    return checked;
+  }
+
   void Do_construct::codegen() const
   {
-    this->initial_expr->codegen();
+    // start, end and stride are evaluated once before the loop, and the iteration
+    // count (end-start+stride)/stride is computed from their values
+    llvm::Value *do_variable = this->do_variable->codegen();
+    llvm::Value *start = this->start_expr->codegen();
+    llvm::Value *end = this->end_expr->codegen();
+    llvm::Value *stride = this->stride_expr->codegen();
+    // the canonical induction variable is always 64-bit, so it needs no extension
+    // for addressing; the do-variable keeps its own kind
+    llvm::Value *trip_count = builder.CreateSDiv(builder.CreateNSWAdd(builder.CreateNSWSub(end, start), stride),
+                                                 stride, "trip_count");
+    if (trip_count->getType() != builder.getInt64Ty()) {
+      trip_count = builder.CreateSExt(trip_count, builder.getInt64Ty());
+    }
+    llvm::Value *zero = builder.getInt64(0);
+    trip_count = builder.CreateSelect(builder.CreateICmpSGT(trip_count, zero),
+                                      trip_count, zero, "trip_count");
+    std::string name = this->do_variable->get_var_name();
+    Type_kind kind = this->do_variable->get_type_kind();
+    active_do_variables.push_back(name);
+    // the checks use the generic stride and trip count, they hold for both versions of the loop
+    std::set<const Array_element_reference*> checked;
+    if (options.check_bounds) checked = this->codegen_bounds_checks(start, stride, trip_count);
+
+    // only innermost loops are versioned, so that the code does not double at every level of a nest
+    if (options.opt_level < 2 || llvm::isa<llvm::Constant>(stride) || this->block->has_do_construct()) {
+      IR_generator::set_access_metadata(builder.CreateStore(start, do_variable), name, kind);
+      this->codegen_loop(do_variable, stride, trip_count, checked);
+      active_do_variables.pop_back();
+      return;
+    }
+    // a stride only known at run time makes every access of the do-variable strided.
+    // the check for the common stride 1 is done in the preheader, and the loop
+    // specialized for it has constant unit-stride accesses and a trip count
+    // without the division
+    llvm::Value *unit_trip_count =
+      builder.CreateNSWAdd(builder.CreateNSWSub(builder.CreateSExt(end, builder.getInt64Ty()),
+                                                builder.CreateSExt(start, builder.getInt64Ty())),
+                           builder.getInt64(1));
+    unit_trip_count = builder.CreateSelect(builder.CreateICmpSGT(unit_trip_count, zero),
+                                           unit_trip_count, zero, "unit_trip_count");
+    IR_generator::set_access_metadata(builder.CreateStore(start, do_variable), name, kind);
 
     llvm::Function *func = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *unit_BB = llvm::BasicBlock::Create(context, "unit_stride", func);
+    llvm::BasicBlock *generic_BB = llvm::BasicBlock::Create(context, "generic_stride");
+    llvm::BasicBlock *merge_BB = llvm::BasicBlock::Create(context, "stride_merge");
+    llvm::Value *one = llvm::ConstantInt::get(stride->getType(), 1);
+    builder.CreateCondBr(builder.CreateICmpEQ(stride, one, "is_unit_stride"), unit_BB, generic_BB);
 
-    llvm::BasicBlock *preheaderBB = builder.GetInsertBlock();
-    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(context, "loop", func);
-    builder.CreateBr(loopBB);
+    builder.SetInsertPoint(unit_BB);
+    this->codegen_loop(do_variable, one, unit_trip_count, checked);
+    builder.CreateBr(merge_BB);
 
-    builder.SetInsertPoint(loopBB);
-    this->block->codegen();
-    this->increment_expr->codegen();
-    llvm::Value *cond = this->condition_expr->codegen();
+    func->getBasicBlockList().push_back(generic_BB);
+    builder.SetInsertPoint(generic_BB);
+    this->codegen_loop(do_variable, stride, trip_count, checked);
+    builder.CreateBr(merge_BB);
 
-    llvm::BasicBlock *loop_end_BB = builder.GetInsertBlock();
-    llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(context, "after_loop", func);
-    builder.CreateCondBr(cond, loopBB, afterBB);
-    builder.SetInsertPoint(afterBB);
+    func->getBasicBlockList().push_back(merge_BB);
+    builder.SetInsertPoint(merge_BB);
+    active_do_variables.pop_back();
   }
 
-  // only main program now
-  void Program_unit::codegen() const
+  // the main program is main(), an external subprogram is name_ like the ones of
+  // gfortran, and an internal one is host.name, local to the object file.
+  // The dummy arguments are pointers to the storage of the actual arguments, which
+  // never overlap when one of them is defined, so they are noalias
+  void Program_unit::declare() const
   {
-    variable_table.clear();
-    procedure_table.clear();
-    
-    llvm::FunctionType *func_type =
-      llvm::FunctionType::get(builder.getInt32Ty(), false);
-    llvm::Function *main_func =
-      llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, "main", module);
-    
-    llvm::BasicBlock *entry = llvm::BasicBlock::Create(context, "entrypoint", main_func);
-    builder.SetInsertPoint(entry);
-
-    for (std::string str : this->global_strings) {
-      global_string_table[str] = builder.CreateGlobalStringPtr(str);
+    llvm::Function *func = nullptr;
+    if (this->interface_only) {
+      // declared by the first call
+    } else if (this->kind == Program_unit_kind::main_program) {
+      // a file of subprograms only has no main program
+      if (!this->name.empty()) {
+        func = llvm::Function::Create(llvm::FunctionType::get(builder.getInt32Ty(), false),
+                                      llvm::Function::ExternalLinkage, "main", module);
+      }
+    } else {
+      const llvm::DataLayout &layout = module->getDataLayout();
+      std::vector<llvm::Type *> param_types;
+      for (auto &dummy : this->dummy_arguments) {
+        param_types.push_back(IR_generator::get_storage_type(dummy->get_type_kind())->getPointerTo());
+      }
+      llvm::Type *return_type = this->kind == Program_unit_kind::function ?
+        IR_generator::get_storage_type(this->result->get_type_kind()) : builder.getVoidTy();
+      if (this->host) {
+        func = llvm::Function::Create(llvm::FunctionType::get(return_type, param_types, false),
+                                      llvm::Function::InternalLinkage, this->host->get_name() + "." + this->name, module);
+      } else {
+        func = llvm::Function::Create(llvm::FunctionType::get(return_type, param_types, false),
+                                      llvm::Function::ExternalLinkage, this->name + "_", module);
+      }
+      for (int i=0; i<this->dummy_arguments.size(); i++) {
+        const Variable &dummy = *this->dummy_arguments[i];
+        llvm::Argument *arg = func->arg_begin() + i;
+        arg->setName(dummy.get_name());
+        uint64_t bytes = layout.getTypeAllocSize(param_types[i]->getPointerElementType());
+        if (dummy.is_array()) bytes *= dummy.get_shape().get_storage_size();
+        func->addParamAttr(i, llvm::Attribute::NoAlias);
+        func->addParamAttr(i, llvm::Attribute::NoCapture);
+        func->addDereferenceableParamAttr(i, bytes);
+      }
     }
-
-    // variable declarations
-    for (auto var_decl : *this->variables) {
-      var_decl.second->codegen();
+    if (func) {
+      IR_generator::set_target_attributes(func);
+      function_table[this] = func;
     }
-    
-    // executable statements
-    for (auto &stmt : this->statements) {
-      stmt->codegen();
+    for (auto &program : this->internal_programs) {
+      program->declare();
+    }
+    for (auto &program : this->external_programs) {
+      program->declare();
     }
+  }
+
+  void Program_unit::codegen() const
+  {
+    auto function = function_table.find(this);
+    if (function != function_table.end()) {
+      llvm::Function *func = function->second;
+      variable_table.clear();
+      procedure_table.clear();
+      is_main_program = this->kind == Program_unit_kind::main_program;
+
+      llvm::BasicBlock *entry = llvm::BasicBlock::Create(context, "entrypoint", func);
+      builder.SetInsertPoint(entry);
+
+      for (std::string str : this->global_strings) {
+        IR_generator::get_string_ptr(str);
+      }
+
+      // the storage of the dummy arguments is the one of the actual arguments,
+      // and the host variables are static storage of the host
+      llvm::Function::arg_iterator arg = func->arg_begin();
+      for (auto &dummy : this->dummy_arguments) {
+        variable_table[dummy->get_name()] = &*arg++;
+      }
+      std::map<std::string, std::shared_ptr<Variable>> scoped_variables = *this->variables;
+      for (auto &var : this->host_variables) {
+        variable_table[var->get_name()] = host_storage_table[var.get()];
+        scoped_variables[var->get_name()] = var;
+      }
+      IR_generator::create_alias_scopes(scoped_variables, this->name);
 
-    builder.CreateRet(builder.getInt32(0));
+      // variable declarations
+      for (auto var_decl : *this->variables) {
+        if (!var_decl.second->is_dummy()) var_decl.second->codegen();
+      }
+
+      // executable statements
+      return_block = llvm::BasicBlock::Create(context, "return");
+      for (auto &stmt : this->statements) {
+        stmt->codegen();
+      }
+      builder.CreateBr(return_block);
+      func->getBasicBlockList().push_back(return_block);
+      builder.SetInsertPoint(return_block);
+
+      IR_generator::free_heap_arrays();
+      if (this->kind == Program_unit_kind::main_program) {
+        builder.CreateRet(builder.getInt32(0));
+      } else if (this->kind == Program_unit_kind::function) {
+        llvm::LoadInst *value = builder.CreateLoad(variable_table[this->result->get_name()], "result");
+        IR_generator::set_access_metadata(value, this->result->get_name(), this->result->get_type_kind());
+        builder.CreateRet(value);
+      } else {
+        builder.CreateRetVoid();
+      }
+    }
+    for (auto &program : this->internal_programs) {
+      program->codegen();
+    }
+    for (auto &program : this->external_programs) {
+      program->codegen();
+    }
   }
 
   void Variable::codegen() const
   {
-    // is just "context" ok for llvm::Type::getInt32Ty(context)?
+    llvm::Type *elm_type = IR_generator::get_storage_type(this->get_type_kind());
     llvm::Value *size = nullptr;
-    if (this->shape) {
-      size = builder.getInt32(this->shape->get_size());
+    if (this->get_type_kind() == Type_kind::character) {
+      size = builder.getInt32(this->get_len().eval_constant_value()+1);
     }
-    
+
+    if (this->has_initial_values()) {
+      this->codegen_initialized(elm_type);
+      if (this->host_associated) host_storage_table[this] = variable_table[this->name];
+      return;
+    }
+
+    if (this->host_associated) {
+      // the internal subprograms reference the same storage, so it is static like
+      // a SAVE variable. Without recursion the host is active only once at a time
+      int64_t count = 1;
+      if (this->shape) {
+        count = this->shape->get_storage_size();
+      } else if (size) {
+        count = this->get_len().eval_constant_value()+1;
+      }
+      variable_table[this->name] = IR_generator::create_static_array(elm_type, count, this->name);
+      host_storage_table[this] = variable_table[this->name];
+      return;
+    }
+
+    if (!this->shape) {
+      variable_table[this->name] = builder.CreateAlloca(elm_type, size, this->name);
+      return;
+    }
+
+    // small arrays stay in the frame, large ones would overflow the stack
+    int64_t count = this->shape->get_storage_size();
+    uint64_t bytes = count * (elm_type->getPrimitiveSizeInBits() / 8);
     llvm::Value *value;
-    if (this->get_type_kind() == Type_kind::i32) {
-      value = builder.CreateAlloca(llvm::Type::getInt32Ty(context), size, this->name);
-    } else if (this->get_type_kind() == Type_kind::fp32) {
-      value = builder.CreateAlloca(llvm::Type::getFloatTy(context), size, this->name);
-    } else if (this->get_type_kind() == Type_kind::logical) {
-      value = builder.CreateAlloca(llvm::Type::getInt32Ty(context), size, this->name);
-    } else if (this->get_type_kind() == Type_kind::character) {
-      value = builder.CreateAlloca(llvm::Type::getInt8Ty(context), builder.getInt32(this->get_len().eval_constant_value()+1), this->name);
+    if (bytes <= options.stack_arrays_limit) {
+      llvm::AllocaInst *alloca = builder.CreateAlloca(elm_type, builder.getInt64(count), this->name);
+      alloca->setAlignment(options.array_alignment);
+      value = alloca;
+    } else if (is_main_program) {
+      // the main program is entered only once, so its arrays can be static
+      value = IR_generator::create_static_array(elm_type, count, this->name);
+    } else {
+      value = IR_generator::create_heap_array(elm_type, builder.getInt64(bytes), this->name);
     }
     variable_table[this->name] = value;
   }
+
+  // DATA values are the initializer of a global, so they cost nothing at run time
+  void Variable::codegen_initialized(llvm::Type *elm_type) const
+  {
+    if (!this->shape) {
+      llvm::Constant *value = this->initial_values[0] ?
+        llvm::cast<llvm::Constant>(this->initial_values[0]->codegen()) : llvm::Constant::getNullValue(elm_type);
+      variable_table[this->name] = new llvm::GlobalVariable(*module, elm_type, this->read_only,
+                                                            llvm::GlobalValue::InternalLinkage, value, this->name);
+      return;
+    }
+    // the storage of the padding stays 0
+    std::vector<llvm::Constant *> values(this->shape->get_storage_size(), llvm::Constant::getNullValue(elm_type));
+    for (int64_t i=0; i<this->initial_values.size(); i++) {
+      if (!this->initial_values[i]) continue;
+      int64_t storage_index = 0;
+      int64_t rest = i;
+      for (int dim=0; dim<this->shape->get_rank(); dim++) {
+        storage_index += rest % this->shape->get_size(dim) * this->shape->get_stride(dim);
+        rest /= this->shape->get_size(dim);
+      }
+      values[storage_index] = llvm::cast<llvm::Constant>(this->initial_values[i]->codegen());
+    }
+    variable_table[this->name] = IR_generator::create_initialized_array(elm_type, values, this->read_only, this->name);
+  }
 }
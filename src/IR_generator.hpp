@@ -1,7 +1,9 @@
 #pragma once
 #include "parser.hpp"
+#include "option.hpp"
 
 namespace IR_generator {
-  void generate_IR(const std::shared_ptr<ast::Program_unit> program, bool debug_mode);
+  void generate_IR(const std::shared_ptr<ast::Program_unit> program, const Compile_options &opts,
+                   std::string source_name, bool debug_mode);
   void codeout(std::string outfile_name);
 }
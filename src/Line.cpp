@@ -37,7 +37,8 @@ bool Line::is_end_of_line()
 {
   int save_ofs = column;
   skip_blanks();
-  if (content.size() == column) {
+  // the rest of the line after '!' is a comment
+  if (content.size() == column || content[column] == '!') {
     return true;
   } else {
     column = save_ofs;
@@ -108,13 +109,35 @@ std::string Line::read_character_constant()
   column = save_ofs;
   return "";
 }
+// blank lines count as comment lines
+bool Line::is_comment_line()
+{
+  size_t begin = content.find_first_not_of(" \t");
+  return begin == std::string::npos || content[begin] == '!';
+}
+// the text after "!dir$" or "!gcc$" when the whole line is a compiler directive
+std::string Line::get_directive()
+{
+  size_t begin = content.find_first_not_of(" \t");
+  if (begin == std::string::npos) {
+    return "";
+  }
+  if (content.compare(begin, 5, "!dir$") == 0 || content.compare(begin, 5, "!gcc$") == 0) {
+    return content.substr(begin + 5);
+  }
+  return "";
+}
 bool Line::read_operator(const std::string op)
 {
   int save_ofs = column;
   skip_blanks();
   if (std::equal(op.begin(), op.end(), content.begin()+column)) {
-    char c = content[column+op.size()];
-    if (isalpha(c) || isdigit(c) || c=='(') {
+    int next = column+op.size();
+    while (is_blank(content[next])) {
+      next++;
+    }
+    char c = content[next];
+    if (isalpha(c) || isdigit(c) || c=='(' || c=='[') {
       column += op.size();
       return true;
     }
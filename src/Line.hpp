@@ -23,6 +23,8 @@ public:
   std::string read_real_constant();
   std::string read_logical_constant();
   std::string read_character_constant();
+  bool is_comment_line();
+  std::string get_directive();
   int get_line_num() {return line_num;};
   int get_column() {return column;};
   void set_column(int n) {column = n;};
@@ -1,10 +1,16 @@
 #include "ast.hpp"
+#include <algorithm>
 namespace ast {
   std::string unary_op_to_string(const unary_op_kind op)
   {
     switch (op) {
     case unary_op_kind::i32tofp32:
+    case unary_op_kind::i64tofp32:
       return "(fp32)";
+    case unary_op_kind::i32toi64:
+      return "(i64)";
+    case unary_op_kind::i64toi32:
+      return "(i32)";
     }
   }
   std::string binary_op_to_string(const binary_op_kind op)
@@ -30,6 +36,8 @@ namespace ast {
       return ">";
     case binary_op_kind::ge:
       return ">=";
+    case binary_op_kind::min:
+      return " min ";
     }
   }
   std::string type_to_string(const enum Type_kind kind)
@@ -66,6 +74,10 @@ namespace ast {
   {
     std::cout << this->value;
   }
+  void Int64_constant::print() const
+  {
+    std::cout << this->value;
+  }
   void FP32_constant::print() const
   {
     std::cout << this->value;
@@ -78,6 +90,38 @@ namespace ast {
   {
     std::cout << this->value;
   }
+  Array_constructor::Array_constructor(std::vector<std::unique_ptr<Expression>> elements)
+    : elements(std::move(elements))
+  {
+    std::vector<std::unique_ptr<Bound>> bounds;
+    bounds.push_back(std::make_unique<Bound>(std::make_unique<Int32_constant>(1),
+                                             std::make_unique<Int32_constant>(this->elements.size())));
+    this->shape = std::make_unique<Shape>(std::move(bounds));
+  }
+  std::unique_ptr<Expression> Array_constructor::get_copy() const
+  {
+    std::vector<std::unique_ptr<Expression>> new_elements;
+    for (auto &element : this->elements) {
+      new_elements.push_back(element->get_copy());
+    }
+    return std::make_unique<Array_constructor>(std::move(new_elements));
+  }
+  bool Array_constructor::is_constant() const
+  {
+    for (auto &element : this->elements) {
+      if (!dynamic_cast<const Constant*>(element.get())) return false;
+    }
+    return true;
+  }
+  void Array_constructor::print() const
+  {
+    std::cout << "[";
+    for (int i=0; i<this->elements.size(); i++) {
+      if (i) std::cout << ",";
+      this->elements[i]->print();
+    }
+    std::cout << "]";
+  }
   void Variable_reference::print() const
   {
     std::cout << this->var->get_name();
@@ -95,6 +139,43 @@ namespace ast {
     this->offset_expr->print();
     std::cout << ")";
   }
+  void Array_section::print() const
+  {
+    std::cout << this->var->get_name() << "(";
+    for (int i=0; i<this->subscripts.size(); i++) {
+      if (i > 0) std::cout << ",";
+      this->subscripts[i].lower->print();
+      if (this->subscripts[i].upper) {
+        std::cout << ":";
+        this->subscripts[i].upper->print();
+        std::cout << ":";
+        this->subscripts[i].stride->print();
+      }
+    }
+    std::cout << ")";
+  }
+  void Function_reference::print() const
+  {
+    std::cout << this->function->get_name() << "(";
+    for (int i=0; i<this->args.size(); i++) {
+      if (i > 0) std::cout << ",";
+      this->args[i]->print();
+    }
+    std::cout << ")";
+  }
+  void Call_statement::print(std::string indent) const
+  {
+    std::cout << indent << "Call statement: " << this->subroutine->get_name() << "(";
+    for (int i=0; i<this->args.size(); i++) {
+      if (i > 0) std::cout << ", ";
+      this->args[i]->print();
+    }
+    std::cout << ")" << std::endl;
+  }
+  void Return_statement::print(std::string indent) const
+  {
+    std::cout << indent << "Return statement" << std::endl;
+  }
   void Assignment_statement::print(std::string indent) const
   {
     std::cout << indent;
@@ -124,26 +205,70 @@ namespace ast {
     std::cout << indent + "  " << "statements in else block:" << std::endl;
     this->else_block->print(indent + "  ");
   }
-  void Do_construct::print(std::string indent) const
+  void Where_construct::print(std::string indent) const
   {
-    std::cout << indent << "Do construct:" << std::endl;
-    std::cout << indent + "  " << "initial_expr:  ";
-    this->initial_expr->print("");
-    if (this->increment_expr) {
-      std::cout << indent + "  " << "increment_expr: ";
-      this->increment_expr->print("");
-    }
-    if (this->condition_expr) {
-      std::cout << indent + "  " << "condition_expr: ";
-      this->condition_expr->print();
+    std::cout << indent << "Where construct:" << std::endl;
+    for (auto &clause : this->clauses) {
+      std::cout << indent + "  " << "mask: ";
+      if (clause.mask) {
+        clause.mask->print();
+      } else {
+        std::cout << "(elsewhere)";
+      }
       std::cout << std::endl;
+      for (auto &assignment : clause.assignments) {
+        assignment->print(indent + "    ");
+      }
     }
+  }
+  void Do_construct::print(std::string indent) const
+  {
+    std::cout << indent << "Do construct:" << std::endl;
+    std::cout << indent + "  " << "do_variable: ";
+    this->do_variable->print();
+    std::cout << std::endl;
+    std::cout << indent + "  " << "start_expr: ";
+    this->start_expr->print();
+    std::cout << std::endl;
+    std::cout << indent + "  " << "end_expr: ";
+    this->end_expr->print();
+    std::cout << std::endl;
+    std::cout << indent + "  " << "stride_expr: ";
+    this->stride_expr->print();
+    std::cout << std::endl;
+    std::cout << indent + "  " << "trip_count_expr: ";
+    this->trip_count_expr->print();
+    std::cout << std::endl;
     std::cout << indent + "  " << "block:" << std::endl;
     this->block->print(indent + "  ");
   }
   void Program_unit::print(std::string indent) const
   {
-    std::cout << indent << "ProgramUnit:" << this->name << std::endl;
+    std::cout << indent << "ProgramUnit:" << this->name;
+    if (this->kind == Program_unit_kind::subroutine) {
+      std::cout << " (subroutine)";
+    } else if (this->kind == Program_unit_kind::function) {
+      std::cout << " (function, result " << this->result->get_name() << ")";
+    }
+    std::cout << std::endl;
+    if (this->interface_only) {
+      std::cout << indent << "  " << "external, interface only" << std::endl;
+      return;
+    }
+    if (!this->dummy_arguments.empty()) {
+      std::cout << indent << "  " << "dummy arguments:";
+      for (auto &dummy : this->dummy_arguments) {
+        std::cout << " " << dummy->get_name();
+      }
+      std::cout << std::endl;
+    }
+    if (!this->host_variables.empty()) {
+      std::cout << indent << "  " << "host variables:";
+      for (auto &var : this->host_variables) {
+        std::cout << " " << var->get_name();
+      }
+      std::cout << std::endl;
+    }
     std::cout << indent << "  " << "variables:" << std::endl;
     for (auto var : *this->variables) {
       var.second->print(indent + "    ");
@@ -162,6 +287,15 @@ namespace ast {
       }
     }
     std::cout << std::endl;
+    for (auto &external_program : this->external_programs) {
+      external_program->print(indent);
+    }
+  }
+  void Program_unit::add_host_variable(std::shared_ptr<Variable> var)
+  {
+    if (std::find(this->host_variables.begin(), this->host_variables.end(), var) == this->host_variables.end()) {
+      this->host_variables.push_back(var);
+    }
   }
   void Variable::print(std::string indent) const
   {
@@ -172,6 +306,18 @@ namespace ast {
       std::cout << ", shape: ";
       this->shape->print();
     }
+    if (this->has_initial_values()) {
+      std::cout << (this->read_only ? ", read-only data" : ", data");
+    }
+    if (this->dummy) std::cout << ", dummy";
+    if (this->host_associated) std::cout << ", host associated";
+  }
+  void Variable::set_initial_value(int64_t index, std::unique_ptr<Expression> value)
+  {
+    if (this->initial_values.empty()) {
+      this->initial_values.resize(this->shape ? this->shape->get_size() : 1);
+    }
+    this->initial_values[index] = std::move(value);
   }
   void Bound::print() const
   {
@@ -197,15 +343,50 @@ namespace ast {
       stmt->print(indent + "  ");
     }
   }
+  bool Block::has_do_construct() const
+  {
+    for (auto &stmt : this->statements) {
+      if (stmt->has_do_construct()) return true;
+    }
+    return false;
+  }
+  bool Block::has_branch_out() const
+  {
+    for (auto &stmt : this->statements) {
+      if (stmt->has_branch_out()) return true;
+    }
+    return false;
+  }
 
   enum Type_kind Unary_op::get_type_kind() const
   {
-    if (this->exp_operator == unary_op_kind::i32tofp32) {
+    switch (this->exp_operator) {
+    case unary_op_kind::i32tofp32:
       assert(this->operand->get_type_kind() == Type_kind::i32);
       return Type_kind::fp32;
+    case unary_op_kind::i32toi64:
+      assert(this->operand->get_type_kind() == Type_kind::i32);
+      return Type_kind::i64;
+    case unary_op_kind::i64toi32:
+      assert(this->operand->get_type_kind() == Type_kind::i64);
+      return Type_kind::i32;
+    case unary_op_kind::i64tofp32:
+      assert(this->operand->get_type_kind() == Type_kind::i64);
+      return Type_kind::fp32;
     }
     return operand->get_type_kind();
   }
+  int64_t Unary_op::eval_constant_value() const
+  {
+    switch (this->exp_operator) {
+    case unary_op_kind::i32toi64:
+      return this->operand->eval_constant_value();
+    case unary_op_kind::i64toi32:
+      return (int32_t)this->operand->eval_constant_value();
+    default:
+      assert(0);
+    }
+  }
   enum Type_kind Binary_op::get_type_kind() const
   {
     if (this->exp_operator == binary_op_kind::eq ||
@@ -224,13 +405,13 @@ namespace ast {
   }
   bool Binary_op::is_constant_int() const
   {
-    if (this->get_type_kind() != Type_kind::i32) return false;
+    if (!is_integer_kind(this->get_type_kind())) return false;
     return lhs->is_constant_int() && rhs->is_constant_int();
   }
-  int Binary_op::eval_constant_value() const
+  int64_t Binary_op::eval_constant_value() const
   {
-    int lval = this->lhs->eval_constant_value();
-    int rval = this->rhs->eval_constant_value();
+    int64_t lval = this->lhs->eval_constant_value();
+    int64_t rval = this->rhs->eval_constant_value();
     switch (this->exp_operator) {
     case binary_op_kind::add:
       return lval + rval;
@@ -240,22 +421,285 @@ namespace ast {
       return lval * rval;
     case binary_op_kind::div:
       return lval / rval;
+    case binary_op_kind::min:
+      return std::min(lval, rval);
     default:
       assert(0);
     }
   }
-  int Shape::get_size(int i) const
+  bool Unary_op::get_affine_form(Affine_form &form) const
+  {
+    // index conversions are assumed not to overflow
+    if (this->exp_operator != unary_op_kind::i32toi64 &&
+        this->exp_operator != unary_op_kind::i64toi32) {
+      return false;
+    }
+    return this->operand->get_affine_form(form);
+  }
+  bool Binary_op::get_affine_form(Affine_form &form) const
+  {
+    Affine_form l, r;
+    if (!this->lhs->get_affine_form(l) || !this->rhs->get_affine_form(r)) return false;
+    switch (this->exp_operator) {
+    case binary_op_kind::add:
+    case binary_op_kind::sub:
+      {
+        int64_t sign = this->exp_operator == binary_op_kind::add ? 1 : -1;
+        form = l;
+        for (auto &term : r.coeffs) {
+          form.coeffs[term.first] += sign * term.second;
+        }
+        form.constant += sign * r.constant;
+        return true;
+      }
+    case binary_op_kind::mul:
+      {
+        // one side has to be a constant
+        if (!l.coeffs.empty()) std::swap(l, r);
+        if (!l.coeffs.empty()) return false;
+        form = r;
+        for (auto &term : form.coeffs) {
+          term.second *= l.constant;
+        }
+        form.constant *= l.constant;
+        return true;
+      }
+    default:
+      return false;
+    }
+  }
+  bool Variable_reference::get_affine_form(Affine_form &form) const
+  {
+    if (this->is_array() || !is_integer_kind(this->get_type_kind())) return false;
+    form.coeffs[this->get_var_name()] = 1;
+    return true;
+  }
+  bool Array_constructor::has_function_reference() const
+  {
+    for (auto &element : this->elements) {
+      if (element->has_function_reference()) return true;
+    }
+    return false;
+  }
+  bool Array_element_reference::has_function_reference() const
+  {
+    for (auto &index : this->indices) {
+      if (index->has_function_reference()) return true;
+    }
+    return false;
+  }
+  bool Array_section::has_function_reference() const
+  {
+    for (auto &subscript : this->subscripts) {
+      if (subscript.lower->has_function_reference()) return true;
+      if (subscript.upper && (subscript.upper->has_function_reference() || subscript.stride->has_function_reference())) {
+        return true;
+      }
+    }
+    return false;
+  }
+  Type_kind Function_reference::get_type_kind() const
+  {
+    return this->function->get_result().get_type_kind();
+  }
+  const Shape& Function_reference::get_shape() const
+  {
+    // the result is a scalar
+    assert(0);
+    return this->function->get_result().get_shape();
+  }
+  std::unique_ptr<Expression> Function_reference::get_copy() const
+  {
+    std::vector<std::unique_ptr<Expression>> new_args;
+    for (auto &arg : this->args) {
+      new_args.push_back(arg->get_copy());
+    }
+    auto copy = std::make_unique<Function_reference>(this->function, std::move(new_args));
+    copy->set_line_num(this->line_num);
+    return copy;
+  }
+  void Function_reference::collect_references(std::vector<const Variable_reference*> &refs) const
+  {
+    for (auto &arg : this->args) {
+      arg->collect_references(refs);
+    }
+  }
+  void Array_element_reference::collect_references(std::vector<const Variable_reference*> &refs) const
+  {
+    refs.push_back(this);
+    for (auto &index : this->indices) {
+      index->collect_references(refs);
+    }
+  }
+  void Array_section::collect_references(std::vector<const Variable_reference*> &refs) const
+  {
+    refs.push_back(this);
+    for (auto &subscript : this->subscripts) {
+      subscript.lower->collect_references(refs);
+      if (subscript.upper) {
+        subscript.upper->collect_references(refs);
+        subscript.stride->collect_references(refs);
+      }
+    }
+  }
+  std::unique_ptr<Expression> Array_section::get_copy() const
+  {
+    std::vector<Section_subscript> new_subscripts;
+    for (auto &subscript : this->subscripts) {
+      Section_subscript copy;
+      copy.lower = subscript.lower->get_copy();
+      if (subscript.upper) {
+        copy.upper = subscript.upper->get_copy();
+        copy.stride = subscript.stride->get_copy();
+      }
+      new_subscripts.push_back(std::move(copy));
+    }
+    auto copy = std::make_unique<Array_section>(this->var, std::move(new_subscripts));
+    copy->set_line_num(this->line_num);
+    return copy;
+  }
+  // the triplets are the dimensions of the section, (u - l + s) / s elements each,
+  // none when it is not positive
+  void Array_section::calc_shape()
+  {
+    std::vector<std::unique_ptr<Bound>> bounds;
+    for (auto &subscript : this->subscripts) {
+      if (!subscript.upper) continue;
+      auto distance = std::make_unique<Binary_op>(binary_op_kind::sub, subscript.upper->get_copy(),
+                                                  subscript.lower->get_copy());
+      auto sum = std::make_unique<Binary_op>(binary_op_kind::add, std::move(distance), subscript.stride->get_copy());
+      auto extent = std::make_unique<Binary_op>(binary_op_kind::div, std::move(sum), subscript.stride->get_copy());
+      bounds.push_back(std::make_unique<Bound>(std::make_unique<Int64_constant>(1), std::move(extent)));
+    }
+    this->shape = std::make_unique<Shape>(std::move(bounds));
+  }
+  bool Variable_reference::get_view(Array_view &view) const
+  {
+    if (!this->is_array()) return false;
+    const Shape &shape = this->get_shape();
+    for (int i=0; i<shape.get_rank(); i++) {
+      view.steps.push_back(shape.get_stride(i));
+      view.extents.push_back(shape.get_size(i));
+    }
+    return true;
+  }
+  bool Array_section::get_view(Array_view &view) const
+  {
+    const Shape &shape = this->var->get_shape();
+    view.base = -shape.get_base_offset();
+    for (int i=0; i<this->subscripts.size(); i++) {
+      const Section_subscript &subscript = this->subscripts[i];
+      if (subscript.lower->is_constant_int()) {
+        view.base += subscript.lower->eval_constant_value() * shape.get_stride(i);
+      } else {
+        view.has_constant_base = false;
+      }
+      if (!subscript.upper) continue;
+      int k = view.steps.size();
+      if (!subscript.stride->is_constant_int() || !this->shape->get_upper_bound(k).is_constant_int()) return false;
+      view.steps.push_back(subscript.stride->eval_constant_value() * shape.get_stride(i));
+      view.extents.push_back(std::max<int64_t>(this->shape->get_upper_bound(k).eval_constant_value(), 0));
+    }
+    return true;
+  }
+  // with a stride or bounds known only at run time, a(:,..,:,l:u,j,..,k) is contiguous
+  // when the triplet l:u has stride 1, and the columns have no padding between them
+  bool Array_section::is_contiguous() const
+  {
+    Array_view view;
+    if (this->get_view(view)) return view.is_contiguous();
+    const Shape &shape = this->var->get_shape();
+    bool has_partial = false;
+    for (int i=0; i<this->subscripts.size(); i++) {
+      const Section_subscript &subscript = this->subscripts[i];
+      if (!subscript.upper) {
+        has_partial = true;
+        continue;
+      }
+      if (has_partial || (i > 0 && shape.is_padded())) return false;
+      bool is_whole = subscript.lower->is_constant_int() && subscript.upper->is_constant_int() &&
+        subscript.lower->eval_constant_value() == shape.get_lower_bound(i).eval_constant_value() &&
+        subscript.upper->eval_constant_value() == shape.get_upper_bound(i).eval_constant_value() &&
+        subscript.stride->is_constant_int() && subscript.stride->eval_constant_value() == 1;
+      if (is_whole) continue;
+      if (!subscript.stride->is_constant_int() || subscript.stride->eval_constant_value() != 1) return false;
+      has_partial = true;
+    }
+    return true;
+  }
+  bool Array_view::is_contiguous() const
+  {
+    int64_t size = 1;
+    for (int k=0; k<this->steps.size(); k++) {
+      if (this->extents[k] == 1) continue;
+      if (this->steps[k] != size) return false;
+      size *= this->extents[k];
+    }
+    return true;
+  }
+  bool Array_view::is_ascending() const
+  {
+    int64_t span = 0;
+    for (int k=0; k<this->steps.size(); k++) {
+      if (this->extents[k] == 1) continue;
+      if (this->steps[k] <= span) return false;
+      span += (this->extents[k] - 1) * this->steps[k];
+    }
+    return true;
+  }
+  int64_t Array_view::get_first() const
+  {
+    int64_t first = this->base;
+    for (int k=0; k<this->steps.size(); k++) {
+      first += std::min<int64_t>((this->extents[k] - 1) * this->steps[k], 0);
+    }
+    return first;
+  }
+  int64_t Array_view::get_last() const
+  {
+    int64_t last = this->base;
+    for (int k=0; k<this->steps.size(); k++) {
+      last += std::max<int64_t>((this->extents[k] - 1) * this->steps[k], 0);
+    }
+    return last;
+  }
+  int64_t Shape::get_size(int i) const
   {
     return bounds[i]->get_upper().eval_constant_value() - bounds[i]->get_lower().eval_constant_value() + 1;
   }
-  int Shape::get_size() const
+  int64_t Shape::get_size() const
   {
-    int sum=1;
+    int64_t sum=1;
     for (int i=0; i<this->bounds.size(); i++) {
       sum = sum * this->get_size(i);
     }
     return sum;
   }
+  int64_t Shape::get_storage_size() const
+  {
+    int rank = this->bounds.size();
+    return this->get_stride(rank-1) * this->get_size(rank-1);
+  }
+
+  // distance in elements between a(..,k,..) and a(..,k+1,..) in the i-th dimension
+  int64_t Shape::get_stride(int i) const
+  {
+    int64_t stride=1;
+    for (int k=0; k<i; k++) {
+      stride = stride * this->get_size(k);
+      if (k == 0) stride += this->padding;
+    }
+    return stride;
+  }
+  // offset of the first element a(lower(0),lower(1),...) from a flat index
+  int64_t Shape::get_base_offset() const
+  {
+    int64_t offset=0;
+    for (int i=0; i<this->bounds.size(); i++) {
+      offset = offset + this->bounds[i]->get_lower().eval_constant_value() * this->get_stride(i);
+    }
+    return offset;
+  }
 
   const Shape& Binary_op::get_shape() const
   {
@@ -268,20 +712,33 @@ namespace ast {
     }
   }
 
+  std::unique_ptr<Expression> get_index_copy(const Expression &index)
+  {
+    if (index.get_type_kind() == Type_kind::i32) {
+      return std::make_unique<Unary_op>(unary_op_kind::i32toi64, index.get_copy());
+    }
+    assert(index.get_type_kind() == index_type_kind);
+    return index.get_copy();
+  }
+
   void Array_element_reference::calc_offset_expr()
   {
     assert(!this->offset_expr);
+    const Shape &shape = this->var->get_shape();
     std::unique_ptr<Expression> expr;
-    // integer :: a(10,3,2)
-    // a(i,j,k)のoffsetは(k*3+j)*10+i
-    expr = this->indices[indices.size()-1]->get_copy();
-    for (int i=indices.size()-2; i>=0; i--) {
-      // mult
-      std::unique_ptr<Int32_constant> size { new Int32_constant(this->var->get_shape().get_size(i)) };
-      expr = std::make_unique<Binary_op>(binary_op_kind::mul, std::move(expr), std::move(size));
-      // add
-      std::unique_ptr<Expression> subscript = this->indices[i]->get_copy();
-      expr = std::make_unique<Binary_op>(binary_op_kind::add, std::move(expr), std::move(subscript));
+    // integer :: a(0:9,3,2)
+    // a(i,j,k)のoffsetはi + j*10 + k*30 - (0 + 1*10 + 1*30)
+    // lower bounds are folded into one constant per array
+    // the offset is computed in index_type_kind, so that arrays larger than 2^31 elements work
+    expr = get_index_copy(*this->indices[0]);
+    for (int i=1; i<indices.size(); i++) {
+      auto stride = std::make_unique<Int64_constant>(shape.get_stride(i));
+      auto term = std::make_unique<Binary_op>(binary_op_kind::mul, get_index_copy(*this->indices[i]), std::move(stride));
+      expr = std::make_unique<Binary_op>(binary_op_kind::add, std::move(expr), std::move(term));
+    }
+    if (shape.get_base_offset() != 0) {
+      auto base_offset = std::make_unique<Int64_constant>(shape.get_base_offset());
+      expr = std::make_unique<Binary_op>(binary_op_kind::sub, std::move(expr), std::move(base_offset));
     }
     this->offset_expr = std::move(expr);
   }
@@ -2,19 +2,34 @@
 #include <iostream>
 #include <string>
 #include <set>
+#include <map>
+#include <vector>
+#include <functional>
 #include "llvm/IR/IRBuilder.h"
 
+namespace loop_optimizer {
+  struct Loop_nest;
+}
+
 namespace ast {
 
   class Expression;
+  class Variable_reference;
+  class Array_constructor;
+  class Do_construct;
+  class Program_unit;
   
   enum class binary_op_kind {
     add, sub, mul, div,
-    eq, ne, lt, le, gt, ge
+    eq, ne, lt, le, gt, ge,
+    min // integer only, made by the loop optimizer
   };
 
   enum class unary_op_kind {
-    i32tofp32
+    i32tofp32,
+    i32toi64,
+    i64toi32,
+    i64tofp32
   };
 
   enum class Type_kind : int {
@@ -27,6 +42,10 @@ namespace ast {
     character
   };
   
+  // index, extent and stride computations are done in this kind
+  const Type_kind index_type_kind = Type_kind::i64;
+  inline bool is_integer_kind(Type_kind kind) {return kind == Type_kind::i32 || kind == Type_kind::i64;}
+
   class Type {
   public:
     Type(Type_kind type_kind) : type_kind(type_kind) {}
@@ -44,6 +63,7 @@ namespace ast {
     const Expression &get_lower() const {return *lower;}
     const Expression &get_upper() const {return *upper;}
     void print() const;
+    void fold_constants();
   private:
     std::unique_ptr<Expression> lower;
     std::unique_ptr<Expression> upper;
@@ -51,16 +71,24 @@ namespace ast {
 
   class Shape {
   public:
-    int get_size(int i) const;
-    int get_size() const;
+    int64_t get_size(int i) const;
+    int64_t get_size() const;
+    // elements of the storage, the padding included
+    int64_t get_storage_size() const;
+    int64_t get_stride(int i) const;
+    int64_t get_base_offset() const;
     Shape(std::vector<std::unique_ptr<Bound>> bounds) : bounds(std::move(bounds)) {}
     void print() const;
     const Expression &get_lower_bound(int index) const {return bounds[index]->get_lower();}
     const Expression &get_upper_bound(int index) const {return bounds[index]->get_upper();}
     int get_rank() const {return bounds.size();}
+    void set_padding(int64_t padding) {this->padding = padding;}
+    bool is_padded() const {return padding != 0;}
+    void fold_constants();
     
   private:
     std::vector<std::unique_ptr<Bound>> bounds;
+    int64_t padding = 0; // elements added to the leading extent in the storage
   };
 
   class Variable {
@@ -75,20 +103,45 @@ namespace ast {
     void set_len(std::unique_ptr<Expression> len) {this->len = std::move(len);}
     const Expression& get_len() const {return *len;}
     const Shape& get_shape() const {return *shape;}
+    Shape& get_shape() {return *shape;}
     std::shared_ptr<Type> get_type() const {return type;}
     bool is_array() const {return array_attr;}
     bool set_array_attr() {array_attr = true;}
+    // DATA statement values by the column-major index of the element, the others are 0
+    void set_initial_value(int64_t index, std::unique_ptr<Expression> value);
+    bool has_initial_values() const {return !initial_values.empty();}
+    const Expression *get_initial_value(int64_t index) const {return initial_values[index].get();}
+    // initialized and never defined, so the storage is read-only
+    void set_read_only() {read_only = true;}
+    bool is_read_only() const {return read_only;}
+    // a dummy argument has the storage of the actual argument, passed by reference
+    void set_dummy() {dummy = true;}
+    bool is_dummy() const {return dummy;}
+    // referenced by an internal subprogram, so the storage is static
+    void set_host_associated() {host_associated = true;}
+    bool is_host_associated() const {return host_associated;}
   private:
     bool array_attr = false;
+    bool read_only = false;
+    bool dummy = false;
+    bool host_associated = false;
+    std::vector<std::unique_ptr<Expression>> initial_values;
     std::string name;
     std::shared_ptr<Type> type;
     std::unique_ptr<Shape> shape;
     std::unique_ptr<Expression> len;
+    void codegen_initialized(llvm::Type *elm_type) const;
+  };
+
+  // sum of coeffs[name]*name + constant over integer scalar variables
+  struct Affine_form {
+    std::map<std::string, int64_t> coeffs;
+    int64_t constant = 0;
   };
 
   class Expression {
   public:
-    virtual int eval_constant_value() const = 0;
+    virtual int64_t eval_constant_value() const = 0;
     virtual void print() const = 0;
     virtual llvm::Value *codegen() const = 0;
     virtual enum Type_kind get_type_kind() const = 0;
@@ -97,6 +150,30 @@ namespace ast {
     virtual ~Expression() {};
     virtual const Shape& get_shape() const = 0;
     virtual bool is_array() const = 0;
+    // value of the element at the flat (column-major) index of a conformable array expression
+    // scalar expressions give the same value for every index
+    virtual llvm::Value *codegen_element(llvm::Value *index) const {return codegen();}
+    // appends the variables read by this expression
+    virtual void collect_references(std::vector<const Variable_reference*> &refs) const {}
+    // appends the array constructors of the array expression
+    virtual void collect_constructors(std::vector<const Array_constructor*> &constructors) const {}
+    // appends the largest scalar subexpressions of the array expression
+    virtual void collect_scalar_operands(std::vector<const Expression*> &operands) const {
+      if (!is_array()) operands.push_back(this);
+    }
+    // false when the expression is not affine
+    virtual bool get_affine_form(Affine_form &form) const {return false;}
+    // true when an array section is read, the elements are then generated by codegen_at()
+    virtual bool has_section() const {return false;}
+    // value of the element at the 0-based position in each dimension of the array expression
+    virtual llvm::Value *codegen_at(const std::vector<llvm::Value *> &position) const {return codegen();}
+    // constant folding, see constant_folder.cpp
+    // the value as a constant node, nullptr when it is not known at compile time
+    virtual std::unique_ptr<Expression> fold() const {return nullptr;}
+    // replaces the constant subexpressions of the operands by their values
+    virtual void fold_operands() {}
+    // true when a function is called to evaluate it
+    virtual bool has_function_reference() const {return false;}
   };
 
   class Binary_op : public Expression {
@@ -105,8 +182,9 @@ namespace ast {
       : exp_operator(op), lhs(std::move(lhs)), rhs(std::move(rhs)) {}
     void print() const;
     llvm::Value *codegen() const;
+    llvm::Value *codegen_element(llvm::Value *index) const;
     enum Type_kind get_type_kind() const;
-    int eval_constant_value() const;
+    int64_t eval_constant_value() const;
     bool is_constant_int() const;
     std::unique_ptr<Expression> get_copy() const {
       return std::make_unique<Binary_op>(exp_operator,
@@ -115,7 +193,31 @@ namespace ast {
     };
     const Shape& get_shape() const;
     bool is_array() const {return lhs->is_array() || rhs->is_array();}
+    void collect_references(std::vector<const Variable_reference*> &refs) const {
+      lhs->collect_references(refs);
+      rhs->collect_references(refs);
+    }
+    void collect_constructors(std::vector<const Array_constructor*> &constructors) const {
+      lhs->collect_constructors(constructors);
+      rhs->collect_constructors(constructors);
+    }
+    void collect_scalar_operands(std::vector<const Expression*> &operands) const {
+      if (!is_array()) {
+        operands.push_back(this);
+        return;
+      }
+      lhs->collect_scalar_operands(operands);
+      rhs->collect_scalar_operands(operands);
+    }
+    bool get_affine_form(Affine_form &form) const;
+    std::unique_ptr<Expression> fold() const;
+    void fold_operands();
+    bool has_section() const {return lhs->has_section() || rhs->has_section();}
+    llvm::Value *codegen_at(const std::vector<llvm::Value *> &position) const;
+    bool has_function_reference() const {return lhs->has_function_reference() || rhs->has_function_reference();}
   private:
+    llvm::Value *codegen_op(llvm::Value *lhs, llvm::Value *rhs) const;
+    llvm::Value *codegen_fmuladd(const std::function<llvm::Value *(const Expression &)> &gen) const;
     binary_op_kind exp_operator;
     std::unique_ptr<Expression> lhs;
     std::unique_ptr<Expression> rhs;
@@ -127,15 +229,34 @@ namespace ast {
       : exp_operator(op), operand(std::move(elm)) {}
     void print() const;
     llvm::Value *codegen() const;
+    llvm::Value *codegen_element(llvm::Value *index) const;
     enum Type_kind get_type_kind() const;
-    int eval_constant_value() const {assert(0);};
-    bool is_constant_int() const {return operand->is_constant_int();};
+    int64_t eval_constant_value() const;
+    bool is_constant_int() const {return is_integer_kind(get_type_kind()) && operand->is_constant_int();};
     std::unique_ptr<Expression> get_copy() const {
       return std::make_unique<Unary_op>(exp_operator, operand->get_copy());
     }
     const Shape& get_shape() const {return operand->get_shape();}
     bool is_array() const {return operand->is_array();}
+    void collect_references(std::vector<const Variable_reference*> &refs) const {operand->collect_references(refs);}
+    void collect_constructors(std::vector<const Array_constructor*> &constructors) const {
+      operand->collect_constructors(constructors);
+    }
+    void collect_scalar_operands(std::vector<const Expression*> &operands) const {
+      if (!is_array()) {
+        operands.push_back(this);
+        return;
+      }
+      operand->collect_scalar_operands(operands);
+    }
+    bool get_affine_form(Affine_form &form) const;
+    std::unique_ptr<Expression> fold() const;
+    void fold_operands();
+    bool has_section() const {return operand->has_section();}
+    llvm::Value *codegen_at(const std::vector<llvm::Value *> &position) const;
+    bool has_function_reference() const {return operand->has_function_reference();}
   private:
+    llvm::Value *codegen_op(llvm::Value *operand) const;
     unary_op_kind exp_operator;
     std::unique_ptr<Expression> operand;
   };
@@ -145,7 +266,7 @@ namespace ast {
     virtual void print() const = 0;
     virtual llvm::Value *codegen() const = 0;
     virtual Type_kind get_type_kind() const = 0;
-    virtual int eval_constant_value() const = 0;
+    virtual int64_t eval_constant_value() const = 0;
     virtual std::unique_ptr<Expression> get_copy() const = 0;
     virtual ~Constant() {};
     const Shape& get_shape() const {return *shape;}
@@ -163,13 +284,29 @@ namespace ast {
     llvm::Value *codegen() const;
     int32_t get_value() const {return value;}
     Type_kind get_type_kind() const {return Type_kind::i32;};
-    int eval_constant_value() const {return value;};
+    int64_t eval_constant_value() const {return value;};
     bool is_constant_int() const {return true;};
     std::unique_ptr<Expression> get_copy() const {return std::make_unique<Int32_constant>(value);}
+    bool get_affine_form(Affine_form &form) const {form.constant = value; return true;}
   private:
     int32_t value;
   };
 
+  class Int64_constant : public Constant {
+  public:
+    Int64_constant(int64_t val) {this->value = val;}
+    void print() const;
+    llvm::Value *codegen() const;
+    int64_t get_value() const {return value;}
+    Type_kind get_type_kind() const {return Type_kind::i64;};
+    int64_t eval_constant_value() const {return value;};
+    bool is_constant_int() const {return true;};
+    std::unique_ptr<Expression> get_copy() const {return std::make_unique<Int64_constant>(value);}
+    bool get_affine_form(Affine_form &form) const {form.constant = value; return true;}
+  private:
+    int64_t value;
+  };
+
   class FP32_constant : public Constant {
   public:
     FP32_constant(float val) {this->value = val;}
@@ -177,7 +314,7 @@ namespace ast {
     llvm::Value *codegen() const;
     float get_value() const {return value;}
     Type_kind get_type_kind() const {return Type_kind::fp32;};
-    int eval_constant_value() const {return (int)value;};
+    int64_t eval_constant_value() const {return (int64_t)value;};
     bool is_constant_int() const {return false;};
     std::unique_ptr<Expression> get_copy() const {return std::make_unique<FP32_constant>(value);}
   private:
@@ -192,7 +329,7 @@ namespace ast {
     bool get_value() const {return value;}
     Type_kind get_type_kind() const {return Type_kind::logical;}
     int get_int_value() const {return 1 ? value : 0;}
-    int eval_constant_value() const {return (int)value;};
+    int64_t eval_constant_value() const {return (int64_t)value;};
     bool is_constant_int() const {return false;};
     std::unique_ptr<Expression> get_copy() const {return std::make_unique<Logical_constant>(value);}
   private:
@@ -207,31 +344,134 @@ namespace ast {
     llvm::Value *codegen_definition() const;
     std::string get_value() const {return value;}
     Type_kind get_type_kind() const {return Type_kind::character;}
-    int eval_constant_value() const {assert(0);};
+    int64_t eval_constant_value() const {assert(0);};
     bool is_constant_int() const {return false;};
     std::unique_ptr<Expression> get_copy() const {return std::make_unique<Character_constant>(value);}
   private:
     std::string value;
   };
 
+  // (/ ... /) with the values flattened, a rank-1 array
+  class Array_constructor : public Expression {
+  public:
+    Array_constructor(std::vector<std::unique_ptr<Expression>> elements);
+    void print() const;
+    llvm::Value *codegen() const;
+    // reads the values built before the loops of the statement, see IR_generator::codegen_constructors()
+    llvm::Value *codegen_element(llvm::Value *index) const;
+    Type_kind get_type_kind() const {return elements[0]->get_type_kind();}
+    int64_t eval_constant_value() const {assert(0);}
+    bool is_constant_int() const {return false;}
+    std::unique_ptr<Expression> get_copy() const;
+    const Shape& get_shape() const {return *shape;}
+    bool is_array() const {return true;}
+    void collect_references(std::vector<const Variable_reference*> &refs) const {
+      for (auto &element : elements) {
+        element->collect_references(refs);
+      }
+    }
+    void collect_constructors(std::vector<const Array_constructor*> &constructors) const {constructors.push_back(this);}
+    // the elements are evaluated when the constructor is built
+    void collect_scalar_operands(std::vector<const Expression*> &operands) const {}
+    void fold_operands();
+    llvm::Value *codegen_at(const std::vector<llvm::Value *> &position) const {return codegen_element(position[0]);}
+    // all the values are known, they are placed in a read-only global
+    bool is_constant() const;
+    std::vector<std::unique_ptr<Expression>> &get_elements() {return elements;}
+    bool has_function_reference() const;
+  private:
+    std::vector<std::unique_ptr<Expression>> elements;
+    std::unique_ptr<Shape> shape;
+  };
+
+  // the storage walked by a whole array or a section: the offset of the first element,
+  // and the storage step and the extent of each dimension
+  struct Array_view {
+    bool has_constant_base = true;
+    int64_t base = 0;
+    std::vector<int64_t> steps;
+    std::vector<int64_t> extents;
+    // the elements are stored one after another in the order they are walked
+    bool is_contiguous() const;
+    // each element is stored after the ones walked before it
+    bool is_ascending() const;
+    // offsets of the first and the last element stored
+    int64_t get_first() const;
+    int64_t get_last() const;
+  };
+
   class Variable_reference : public Expression {
   public:
     virtual void print() const;
     virtual llvm::Value *codegen() const;
+    llvm::Value *codegen_element(llvm::Value *index) const;
     Variable_reference(std::shared_ptr<Variable> var) : var(var) {};
     Type_kind get_type_kind() const {return var->get_type_kind();}
-    int eval_constant_value() const {assert(0);};
+    int64_t eval_constant_value() const {assert(0);};
     bool is_constant_int() const {return false;};
     std::string get_var_name() const {return var->get_name();}
     virtual std::unique_ptr<Expression> get_copy() const {return std::make_unique<Variable_reference>(var);}
     const Shape& get_shape() const {return var->get_shape();}
+    // the shape of the variable, a section has the shape of its triplets
+    const Shape& get_var_shape() const {return var->get_shape();}
     virtual bool is_array() const {return var->is_array();}
     std::shared_ptr<Type> get_type() const {return var->get_type();}
+    virtual void collect_references(std::vector<const Variable_reference*> &refs) const {refs.push_back(this);}
+    virtual bool get_affine_form(Affine_form &form) const;
+    virtual std::unique_ptr<Expression> fold() const;
+    llvm::Value *codegen_at(const std::vector<llvm::Value *> &position) const;
+    // pointer to the element of a whole array or a section at the position
+    virtual llvm::Value *codegen_ptr_at(const std::vector<llvm::Value *> &position) const;
+    // false when it is not an array or the steps and extents are not constant
+    virtual bool get_view(Array_view &view) const;
   protected:
     std::shared_ptr<Variable> var;
     Variable_reference() {};
   };
 
+  // a subscript of an array section, a triplet when upper is not nullptr
+  struct Section_subscript {
+    std::unique_ptr<Expression> lower; // the subscript when it is not a triplet
+    std::unique_ptr<Expression> upper;
+    std::unique_ptr<Expression> stride;
+  };
+
+  // a(l:u:s, j), a view of the storage of a. No copy is made, the elements are
+  // read and written in place
+  class Array_section : virtual public Variable_reference {
+  public:
+    Array_section(std::shared_ptr<Variable> var, std::vector<Section_subscript> subscripts)
+      : Variable_reference(var), subscripts(std::move(subscripts)) {
+      calc_shape();
+    }
+    void print() const;
+    // pointer to the first element
+    virtual llvm::Value *codegen() const;
+    std::unique_ptr<Expression> get_copy() const;
+    const Shape& get_shape() const {return *shape;}
+    bool is_array() const {return true;}
+    void collect_references(std::vector<const Variable_reference*> &refs) const;
+    bool get_affine_form(Affine_form &form) const {return false;}
+    std::unique_ptr<Expression> fold() const {return nullptr;}
+    void fold_operands();
+    bool has_section() const {return true;}
+    llvm::Value *codegen_ptr_at(const std::vector<llvm::Value *> &position) const;
+    bool get_view(Array_view &view) const;
+    bool has_function_reference() const;
+    // the elements are stored one after another, so it can be passed as an array argument
+    bool is_contiguous() const;
+    const std::vector<Section_subscript> &get_subscripts() const {return subscripts;}
+    void set_line_num(int line_num) {this->line_num = line_num;}
+    int get_line_num() const {return line_num;}
+  protected:
+    std::vector<Section_subscript> subscripts;
+    std::unique_ptr<Shape> shape; // 1:extent for each triplet
+    int line_num = 0; // for bounds checking
+    void calc_shape();
+    llvm::Value *codegen_offset(const std::vector<llvm::Value *> &position) const;
+    Array_section() {};
+  };
+
   class Array_element_reference : virtual public Variable_reference {
   public:
     void print() const;
@@ -246,11 +486,26 @@ namespace ast {
       for (auto &index : this->indices) {
         new_indices.push_back(index->get_copy());
       }
-      return std::make_unique<Array_element_reference>(var, std::move(new_indices));
+      auto copy = std::make_unique<Array_element_reference>(var, std::move(new_indices));
+      copy->set_line_num(this->line_num);
+      return copy;
     }
+    bool is_array() const {return false;}
+    llvm::Value *codegen_element(llvm::Value *index) const {return codegen();}
+    void collect_references(std::vector<const Variable_reference*> &refs) const;
+    bool get_affine_form(Affine_form &form) const {return false;}
+    std::unique_ptr<Expression> fold() const;
+    void fold_operands();
+    const std::vector<std::unique_ptr<Expression>> &get_indices() const {return indices;}
+    // flat column-major offset from the first element
+    const Expression &get_offset_expr() const {return *offset_expr;}
+    void set_line_num(int line_num) {this->line_num = line_num;}
+    int get_line_num() const {return line_num;}
+    bool has_function_reference() const;
   protected:
     std::vector<std::unique_ptr<Expression>> indices;
     std::unique_ptr<Expression> offset_expr;
+    int line_num = 0; // for bounds checking
     void calc_offset_expr();
     Array_element_reference() {};
   };
@@ -273,11 +528,68 @@ namespace ast {
     bool is_array() const {return false;}
   };
   
+  class Array_section_definition : public Variable_definition,
+                                   public Array_section {
+  public:
+    llvm::Value *codegen() const {return Array_section::codegen();}
+    Array_section_definition(std::shared_ptr<Variable> var, std::vector<Section_subscript> subscripts)
+      : Variable_reference(var), Variable_definition(var), Array_section(var, std::move(subscripts)) {}
+    bool is_array() const {return true;}
+  };
+
+  // f(args), a reference to a function program unit. The arguments are passed by
+  // reference like the ones of a CALL, a function doesn't define them
+  class Function_reference : public Expression {
+  public:
+    Function_reference(const Program_unit *function, std::vector<std::unique_ptr<Expression>> args)
+      : function(function), args(std::move(args)) {}
+    void print() const;
+    llvm::Value *codegen() const;
+    Type_kind get_type_kind() const;
+    int64_t eval_constant_value() const {assert(0);}
+    bool is_constant_int() const {return false;}
+    std::unique_ptr<Expression> get_copy() const;
+    const Shape& get_shape() const;
+    bool is_array() const {return false;}
+    void collect_references(std::vector<const Variable_reference*> &refs) const;
+    void fold_operands();
+    bool has_function_reference() const {return true;}
+    void set_line_num(int line_num) {this->line_num = line_num;}
+  private:
+    const Program_unit *function;
+    std::vector<std::unique_ptr<Expression>> args;
+    int line_num = 0; // for optimization reports
+  };
+
+  // a variable read or written by a statement
+  struct Memory_access {
+    const Variable_reference *ref;
+    bool is_write;
+  };
+  // an array reference of a loop body that is prefetched ahead of the loop
+  struct Prefetch_stream {
+    const Array_element_reference *ref;
+    int64_t step; // elements per iteration
+    bool is_write;
+  };
+
   class Statement {
   public:
     virtual void print(std::string indent) const = 0;
     virtual void codegen() const = 0;
     virtual ~Statement() {};
+    // loop transformations, see loop_optimizer.cpp
+    virtual void optimize_loops() {}
+    // appends the accesses of the statement, false when they can't be analyzed
+    virtual bool collect_accesses(std::vector<Memory_access> &accesses) const {return false;}
+    // constant folding, see constant_folder.cpp
+    virtual void fold_constants() {}
+    // adds the number of times each scalar variable is defined
+    virtual void count_definitions(std::map<std::string, int> &counts) const {}
+    // the statement is a DO construct or has one nested in it
+    virtual bool has_do_construct() const {return false;}
+    // control may leave the enclosing constructs from the statement, like by RETURN
+    virtual bool has_branch_out() const {return false;}
   };
 
   class Assignment_statement : public Statement {
@@ -287,16 +599,54 @@ namespace ast {
       : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
     void print(std::string indent) const;
     void codegen() const;
+    bool collect_accesses(std::vector<Memory_access> &accesses) const;
+    void fold_constants();
+    void count_definitions(std::map<std::string, int> &counts) const;
+    // remember the variable when it is a scalar defined only here, by a constant
+    void propagate_constant(const std::map<std::string, int> &counts) const;
+    const Variable_definition &get_lhs() const {return *lhs;}
+    const Expression &get_rhs() const {return *rhs;}
+    // the element at index is defined only where the i1 mask is true, see Where_construct
+    // value is the one of the right-hand side when it is already evaluated
+    void codegen_masked(llvm::Value *mask, llvm::Value *index, llvm::Value *value=nullptr) const;
   private:
+    void codegen_section() const;
+    // the right-hand side may read an element of lhs defined before it
+    bool needs_temporary() const;
     std::unique_ptr<Variable_definition> lhs;
     std::unique_ptr<Expression> rhs;
   };
 
+  // CALL of a subroutine. Variables, array elements and sections are passed as
+  // Variable_definition, since the subroutine may define them; other expressions
+  // are passed in a temporary
+  class Call_statement : public Statement {
+  public:
+    Call_statement(const Program_unit *subroutine, std::vector<std::unique_ptr<Expression>> args, int line_num)
+      : subroutine(subroutine), args(std::move(args)), line_num(line_num) {}
+    void print(std::string indent) const;
+    void codegen() const;
+    void fold_constants();
+    void count_definitions(std::map<std::string, int> &counts) const;
+  private:
+    const Program_unit *subroutine;
+    std::vector<std::unique_ptr<Expression>> args;
+    int line_num;
+  };
+
+  class Return_statement : public Statement {
+  public:
+    void print(std::string indent) const;
+    void codegen() const;
+    bool has_branch_out() const {return true;}
+  };
+
   class Output_statement : public Statement {
   public:
     void print(std::string indent) const;
     void codegen() const;
     void add_element(std::unique_ptr<Expression> elm) {this->elements.push_back(std::move(elm));};
+    void fold_constants();
   private:
     std::vector<std::unique_ptr<Expression>> elements;
   };
@@ -313,29 +663,80 @@ namespace ast {
     void add_statement(std::unique_ptr<Statement> stmt) {statements.push_back(std::move(stmt));}
     void print (std::string indent) const;
     void codegen() const;
+    void optimize_loops();
+    bool collect_accesses(std::vector<Memory_access> &accesses) const;
+    void fold_constants();
+    void count_definitions(std::map<std::string, int> &counts) const;
+    // the DO construct when the block consists of nothing else
+    Do_construct *get_single_loop() const;
+    bool has_do_construct() const;
+    bool has_branch_out() const;
+    // array elements referenced on every execution of the block
+    void collect_unconditional_elements(std::vector<const Array_element_reference*> &elements) const;
+    void append(Block &other);
   private:
     std::vector<std::unique_ptr<Statement>> statements;
 
   };
 
+  // !dir$ lines written just before a DO statement
+  struct Loop_directives {
+    int64_t block_size = -1; // block(n), the tile size. not given when negative
+    int64_t unroll = -1; // unroll(n), 0 leaves the count to the optimizer, 1 is nounroll
+    bool ivdep = false; // no loop-carried dependence between memory accesses
+    bool vector_always = false;
+    bool novector = false;
+    // unroll, ivdep and vector are lowered to loop metadata
+    bool has_codegen_hints() const { return unroll >= 0 || ivdep || vector_always || novector; }
+  };
+
   class Do_construct : public Construct {
   public:
     void print(std::string indent) const;
     void codegen() const;
-    Do_construct(std::unique_ptr<Assignment_statement> initial_expr,
-                 std::unique_ptr<Assignment_statement> increment_expr,
-                 std::unique_ptr<Expression> condition_expr,
+    Do_construct(std::unique_ptr<Variable_definition> do_variable,
+                 std::unique_ptr<Expression> start_expr,
+                 std::unique_ptr<Expression> end_expr,
+                 std::unique_ptr<Expression> stride_expr,
+                 std::unique_ptr<Expression> trip_count_expr,
                  std::unique_ptr<Block> block) {
-      this->initial_expr = std::move(initial_expr);
-      this->increment_expr = std::move(increment_expr);
-      this->condition_expr = std::move(condition_expr);
+      this->do_variable = std::move(do_variable);
+      this->start_expr = std::move(start_expr);
+      this->end_expr = std::move(end_expr);
+      this->stride_expr = std::move(stride_expr);
+      this->trip_count_expr = std::move(trip_count_expr);
       this->block = std::move(block);
     }
+    void optimize_loops();
+    void fold_constants();
+    void count_definitions(std::map<std::string, int> &counts) const;
+    static bool fuse(Do_construct &first, Do_construct &second);
+    bool has_do_construct() const {return true;}
+    bool has_branch_out() const {return block->has_branch_out();}
+    void set_line_num(int line_num) {this->line_num = line_num;}
+    void set_directives(const Loop_directives &directives) {this->directives = directives;}
   private:
+    void codegen_loop(llvm::Value *do_variable, llvm::Value *stride, llvm::Value *trip_count,
+                      const std::set<const Array_element_reference*> &checked) const;
+    std::set<const Array_element_reference*>
+    codegen_bounds_checks(llvm::Value *start, llvm::Value *stride, llvm::Value *trip_count) const;
+    void plan_prefetches();
+    std::vector<Do_construct*> get_perfect_nest();
+    bool analyze_nest(loop_optimizer::Loop_nest &nest);
+    bool interchange_loops();
+    bool tile_loops();
+    void swap_header(Do_construct &other);
+    int line_num = 0;
+    Loop_directives directives;
+    std::vector<Prefetch_stream> prefetch_streams; // set for innermost loops by -fprefetch-loop-arrays
     std::unique_ptr<Block> block;
-    std::unique_ptr<Assignment_statement> initial_expr;
-    std::unique_ptr<Assignment_statement> increment_expr;
-    std::unique_ptr<Expression> condition_expr;
+    std::unique_ptr<Variable_definition> do_variable;
+    std::unique_ptr<Expression> start_expr;
+    std::unique_ptr<Expression> end_expr;
+    std::unique_ptr<Expression> stride_expr;
+    // (end-start+stride)/stride, for the loop optimizer. The loop computes it from
+    // the values of start, end and stride, clamped to 0 when the loop is entered
+    std::unique_ptr<Expression> trip_count_expr;
   };
 
   class If_construct : public Construct {
@@ -348,28 +749,99 @@ namespace ast {
       : condition_expression(std::move(expr)), then_block(std::move(then_block)), else_block(std::move(else_block)) {};
     void print(std::string indent) const;
     void codegen() const;
+    void optimize_loops();
+    bool collect_accesses(std::vector<Memory_access> &accesses) const;
+    void fold_constants();
+    void count_definitions(std::map<std::string, int> &counts) const;
+    bool has_do_construct() const {return then_block->has_do_construct() || else_block->has_do_construct();}
+    bool has_branch_out() const {return then_block->has_branch_out() || else_block->has_branch_out();}
   private:
     std::unique_ptr<Expression> condition_expression;
     std::unique_ptr<Block> then_block;
     std::unique_ptr<Block> else_block;
   };
 
+  // WHERE and its ELSEWHERE clauses, the mask of the last one may be nullptr
+  struct Where_clause {
+    std::unique_ptr<Expression> mask;
+    std::vector<std::unique_ptr<Assignment_statement>> assignments;
+  };
+
+  class Where_construct : public Construct {
+  public:
+    void print(std::string indent) const;
+    void codegen() const;
+    void add_clause(std::unique_ptr<Expression> mask) {clauses.push_back({std::move(mask), {}});}
+    void add_assignment(std::unique_ptr<Assignment_statement> stmt) {clauses.back().assignments.push_back(std::move(stmt));}
+    void fold_constants();
+    void count_definitions(std::map<std::string, int> &counts) const;
+  private:
+    // a scalar element of an array defined in the construct is read
+    bool needs_temporaries() const;
+    void codegen_with_temporaries() const;
+    std::vector<Where_clause> clauses;
+  };
+
+  enum class Program_unit_kind {
+    main_program,
+    subroutine,
+    function
+  };
+
+  // the main program keeps the external subprograms of the file
   class Program_unit {
   public:
     void print(std::string indent) const;
+    // creates the llvm::Function of every program unit, so that they can be called in any order
+    void declare() const;
     void codegen() const;
-    Program_unit(std::string name) {this->name = name; }
+    void optimize_loops();
+    void fold_constants();
+    Program_unit(std::string name, Program_unit_kind kind = Program_unit_kind::main_program)
+      : name(name), kind(kind),
+        variables(std::make_unique<std::map<std::string, std::shared_ptr<Variable>>>()),
+        types(std::make_unique<std::map<std::string, std::shared_ptr<Type>>>()) {}
+    std::string get_name() const {return name;}
+    Program_unit_kind get_kind() const {return kind;}
     void add_statement(std::unique_ptr<Statement> stmt) {this->statements.push_back(std::move(stmt));};
-    void add_internal_program(std::unique_ptr<Program_unit>);
-    void set_variables(std::unique_ptr<std::map<std::string, std::shared_ptr<Variable>>> table) {this->variables = std::move(table);}
-    void set_types(std::unique_ptr<std::map<std::string, std::shared_ptr<Type>>> table) {this->types = std::move(table);}
+    void add_internal_program(std::shared_ptr<Program_unit> program) {internal_programs.push_back(program);}
+    void add_external_program(std::shared_ptr<Program_unit> program) {external_programs.push_back(program);}
+    std::map<std::string, std::shared_ptr<Variable>> &get_variables() {return *variables;}
+    std::map<std::string, std::shared_ptr<Type>> &get_types() {return *types;}
     void add_global_string(std::string str) {global_strings.insert(str);};
+    void add_variable(std::shared_ptr<Variable> var) {(*variables)[var->get_name()] = var;}
+    void add_dummy_argument(std::shared_ptr<Variable> var) {dummy_arguments.push_back(var);}
+    const std::vector<std::shared_ptr<Variable>> &get_dummy_arguments() const {return dummy_arguments;}
+    // the variable holding the value of a function
+    void set_result(std::shared_ptr<Variable> var) {result = var;}
+    const Variable &get_result() const {return *result;}
+    void set_host(const Program_unit *host) {this->host = host;}
+    const Program_unit *get_host() const {return host;}
+    // variables of the host referenced by this internal subprogram
+    void add_host_variable(std::shared_ptr<Variable> var);
+    // names of the variables of the host defined by this subprogram or the ones it calls
+    void add_host_definition(std::string name) {host_definitions.insert(name);}
+    const std::set<std::string> &get_host_definitions() const {return host_definitions;}
+    void add_callee(const Program_unit *callee) {callees.insert(callee);}
+    const std::set<const Program_unit*> &get_callees() const {return callees;}
+    // an external subprogram of another file, only the CALL statements are known
+    void set_interface_only() {interface_only = true;}
+    bool is_interface_only() const {return interface_only;}
   private:
     std::string name;
+    Program_unit_kind kind;
     std::vector<std::unique_ptr<Statement>> statements;
     std::vector<std::shared_ptr<Program_unit>> internal_programs;
+    std::vector<std::shared_ptr<Program_unit>> external_programs;
     std::unique_ptr<std::map<std::string, std::shared_ptr<Variable>>> variables;
     std::unique_ptr<std::map<std::string, std::shared_ptr<Type>>> types;
     std::set<std::string> global_strings;
+    std::vector<std::shared_ptr<Variable>> dummy_arguments;
+    std::shared_ptr<Variable> result;
+    const Program_unit *host = nullptr;
+    std::vector<std::shared_ptr<Variable>> host_variables;
+    std::set<std::string> host_definitions;
+    std::set<const Program_unit*> callees;
+    bool interface_only = false;
   };
 }
@@ -0,0 +1,377 @@
+#include "constant_folder.hpp"
+#include <cmath>
+#include <limits>
+
+/* AST -> AST constant folding and propagation, done before the loop optimizer */
+
+// values of the scalars defined once, by a constant, in the statements folded so far
+static std::map<std::string, std::unique_ptr<ast::Expression>> constant_table;
+
+namespace constant_folder {
+  void fold_expression(std::unique_ptr<ast::Expression> &expr) {
+    expr->fold_operands();
+    if (std::unique_ptr<ast::Expression> value = expr->fold()) {
+      expr = std::move(value);
+    }
+  }
+  bool is_constant(const ast::Expression &expr) {
+    return dynamic_cast<const ast::Constant*>(&expr);
+  }
+  // nullptr when the value does not fit in the kind, overflow is left to the run time
+  std::unique_ptr<ast::Expression> make_int_constant(ast::Type_kind kind, int64_t value) {
+    if (kind == ast::Type_kind::i64) {
+      return std::make_unique<ast::Int64_constant>(value);
+    }
+    if (value < std::numeric_limits<int32_t>::min() || value > std::numeric_limits<int32_t>::max()) {
+      return nullptr;
+    }
+    return std::make_unique<ast::Int32_constant>(value);
+  }
+  std::unique_ptr<ast::Expression> fold_integer_op(ast::binary_op_kind op, ast::Type_kind kind, int64_t l, int64_t r) {
+    int64_t value;
+    switch (op) {
+    case ast::binary_op_kind::add:
+      if (__builtin_add_overflow(l, r, &value)) return nullptr;
+      return make_int_constant(kind, value);
+    case ast::binary_op_kind::sub:
+      if (__builtin_sub_overflow(l, r, &value)) return nullptr;
+      return make_int_constant(kind, value);
+    case ast::binary_op_kind::mul:
+      if (__builtin_mul_overflow(l, r, &value)) return nullptr;
+      return make_int_constant(kind, value);
+    case ast::binary_op_kind::div:
+      if (r == 0 || (l == std::numeric_limits<int64_t>::min() && r == -1)) return nullptr;
+      return make_int_constant(kind, l / r);
+    case ast::binary_op_kind::min:
+      return make_int_constant(kind, std::min(l, r));
+    case ast::binary_op_kind::eq:
+      return std::make_unique<ast::Logical_constant>(l == r);
+    case ast::binary_op_kind::ne:
+      return std::make_unique<ast::Logical_constant>(l != r);
+    case ast::binary_op_kind::lt:
+      return std::make_unique<ast::Logical_constant>(l < r);
+    case ast::binary_op_kind::le:
+      return std::make_unique<ast::Logical_constant>(l <= r);
+    case ast::binary_op_kind::gt:
+      return std::make_unique<ast::Logical_constant>(l > r);
+    case ast::binary_op_kind::ge:
+      return std::make_unique<ast::Logical_constant>(l >= r);
+    }
+    return nullptr;
+  }
+  // the comparisons are the unordered ones of the generated code, true when either is NaN
+  std::unique_ptr<ast::Expression> fold_fp32_op(ast::binary_op_kind op, float l, float r) {
+    bool unordered = std::isnan(l) || std::isnan(r);
+    switch (op) {
+    case ast::binary_op_kind::add:
+      return std::make_unique<ast::FP32_constant>(l + r);
+    case ast::binary_op_kind::sub:
+      return std::make_unique<ast::FP32_constant>(l - r);
+    case ast::binary_op_kind::mul:
+      return std::make_unique<ast::FP32_constant>(l * r);
+    case ast::binary_op_kind::div:
+      return std::make_unique<ast::FP32_constant>(l / r);
+    case ast::binary_op_kind::eq:
+      return std::make_unique<ast::Logical_constant>(unordered || l == r);
+    case ast::binary_op_kind::ne:
+      return std::make_unique<ast::Logical_constant>(unordered || l != r);
+    case ast::binary_op_kind::lt:
+      return std::make_unique<ast::Logical_constant>(unordered || l < r);
+    case ast::binary_op_kind::le:
+      return std::make_unique<ast::Logical_constant>(unordered || l <= r);
+    case ast::binary_op_kind::gt:
+      return std::make_unique<ast::Logical_constant>(unordered || l > r);
+    case ast::binary_op_kind::ge:
+      return std::make_unique<ast::Logical_constant>(unordered || l >= r);
+    default:
+      return nullptr;
+    }
+  }
+  // the value of the elements without an initial value
+  std::unique_ptr<ast::Expression> make_zero(ast::Type_kind kind) {
+    switch (kind) {
+    case ast::Type_kind::i64:
+      return std::make_unique<ast::Int64_constant>(0);
+    case ast::Type_kind::fp32:
+      return std::make_unique<ast::FP32_constant>(0.0);
+    case ast::Type_kind::logical:
+      return std::make_unique<ast::Logical_constant>(false);
+    default:
+      return std::make_unique<ast::Int32_constant>(0);
+    }
+  }
+  void fold(const std::shared_ptr<ast::Program_unit> program) {
+    constant_table.clear();
+    program->fold_constants();
+    // the values belong to this program unit
+    constant_table.clear();
+  }
+}
+
+namespace ast {
+  std::unique_ptr<Expression> Binary_op::fold() const
+  {
+    if (!constant_folder::is_constant(*this->lhs) || !constant_folder::is_constant(*this->rhs)) return nullptr;
+    Type_kind kind = this->lhs->get_type_kind();
+    if (is_integer_kind(kind)) {
+      return constant_folder::fold_integer_op(this->exp_operator, kind,
+                                              this->lhs->eval_constant_value(), this->rhs->eval_constant_value());
+    } else if (kind == Type_kind::fp32) {
+      return constant_folder::fold_fp32_op(this->exp_operator,
+                                           static_cast<const FP32_constant&>(*this->lhs).get_value(),
+                                           static_cast<const FP32_constant&>(*this->rhs).get_value());
+    }
+    return nullptr;
+  }
+  void Binary_op::fold_operands()
+  {
+    constant_folder::fold_expression(this->lhs);
+    constant_folder::fold_expression(this->rhs);
+  }
+  std::unique_ptr<Expression> Unary_op::fold() const
+  {
+    if (!constant_folder::is_constant(*this->operand)) return nullptr;
+    int64_t value = this->operand->eval_constant_value();
+    switch (this->exp_operator) {
+    case unary_op_kind::i32tofp32:
+    case unary_op_kind::i64tofp32:
+      return std::make_unique<FP32_constant>(static_cast<float>(value));
+    case unary_op_kind::i32toi64:
+      return std::make_unique<Int64_constant>(value);
+    case unary_op_kind::i64toi32:
+      return std::make_unique<Int32_constant>(static_cast<int32_t>(value));
+    }
+    return nullptr;
+  }
+  void Unary_op::fold_operands()
+  {
+    constant_folder::fold_expression(this->operand);
+  }
+  std::unique_ptr<Expression> Variable_reference::fold() const
+  {
+    auto it = constant_table.find(this->get_var_name());
+    if (it == constant_table.end()) return nullptr;
+    return it->second->get_copy();
+  }
+  // an element of a read-only DATA array at constant subscripts
+  std::unique_ptr<Expression> Array_element_reference::fold() const
+  {
+    if (!this->var->is_read_only()) return nullptr;
+    const Shape &shape = this->var->get_shape();
+    int64_t index = 0;
+    int64_t size = 1;
+    for (int i=0; i<shape.get_rank(); i++) {
+      if (!constant_folder::is_constant(*this->indices[i]) || !is_integer_kind(this->indices[i]->get_type_kind())) {
+        return nullptr;
+      }
+      int64_t subscript = this->indices[i]->eval_constant_value() - shape.get_lower_bound(i).eval_constant_value();
+      // out of bounds is left to the run time
+      if (subscript < 0 || subscript >= shape.get_size(i)) return nullptr;
+      index += subscript * size;
+      size *= shape.get_size(i);
+    }
+    const Expression *value = this->var->get_initial_value(index);
+    return value ? value->get_copy() : constant_folder::make_zero(this->get_type_kind());
+  }
+  void Array_constructor::fold_operands()
+  {
+    for (auto &element : this->elements) {
+      constant_folder::fold_expression(element);
+    }
+  }
+  void Array_element_reference::fold_operands()
+  {
+    for (auto &index : this->indices) {
+      constant_folder::fold_expression(index);
+    }
+    // the offset was built from copies of the indices
+    this->offset_expr.reset();
+    this->calc_offset_expr();
+  }
+  void Array_section::fold_operands()
+  {
+    for (auto &subscript : this->subscripts) {
+      constant_folder::fold_expression(subscript.lower);
+      if (subscript.upper) {
+        constant_folder::fold_expression(subscript.upper);
+        constant_folder::fold_expression(subscript.stride);
+      }
+    }
+    // the extents were built from copies of the subscripts
+    this->calc_shape();
+    this->shape->fold_constants();
+  }
+  // the variables passed keep their storage, only their subscripts are folded
+  void fold_arguments(std::vector<std::unique_ptr<Expression>> &args)
+  {
+    for (auto &arg : args) {
+      if (dynamic_cast<Variable_definition*>(arg.get())) {
+        arg->fold_operands();
+      } else {
+        constant_folder::fold_expression(arg);
+      }
+    }
+  }
+  void Function_reference::fold_operands()
+  {
+    fold_arguments(this->args);
+  }
+  void Bound::fold_constants()
+  {
+    constant_folder::fold_expression(this->lower);
+    constant_folder::fold_expression(this->upper);
+  }
+  void Shape::fold_constants()
+  {
+    for (auto &bound : this->bounds) {
+      bound->fold_constants();
+    }
+  }
+
+  void Assignment_statement::fold_constants()
+  {
+    this->lhs->fold_operands();
+    constant_folder::fold_expression(this->rhs);
+  }
+  void Assignment_statement::count_definitions(std::map<std::string, int> &counts) const
+  {
+    // arrays are counted as a whole
+    counts[this->lhs->get_var_name()]++;
+  }
+  void Assignment_statement::propagate_constant(const std::map<std::string, int> &counts) const
+  {
+    if (this->lhs->is_array() || dynamic_cast<const Array_element_definition*>(this->lhs.get())) return;
+    std::string name = this->lhs->get_var_name();
+    auto it = counts.find(name);
+    if (it == counts.end() || it->second != 1 || !constant_folder::is_constant(*this->rhs) ||
+        this->lhs->get_type_kind() == Type_kind::character ||
+        this->rhs->get_type_kind() != this->lhs->get_type_kind()) {
+      return;
+    }
+    constant_table[name] = this->rhs->get_copy();
+  }
+  void Call_statement::fold_constants()
+  {
+    fold_arguments(this->args);
+  }
+  // the subroutine may define every variable passed, and the variables of the host
+  // it defines by host association
+  void Call_statement::count_definitions(std::map<std::string, int> &counts) const
+  {
+    for (auto &arg : this->args) {
+      if (auto *var = dynamic_cast<const Variable_definition*>(arg.get())) {
+        counts[var->get_var_name()]++;
+      }
+    }
+    for (auto &name : this->subroutine->get_host_definitions()) {
+      counts[name]++;
+    }
+  }
+  void Output_statement::fold_constants()
+  {
+    for (auto &element : this->elements) {
+      constant_folder::fold_expression(element);
+    }
+  }
+  void Block::fold_constants()
+  {
+    for (auto &stmt : this->statements) {
+      stmt->fold_constants();
+    }
+  }
+  void Block::count_definitions(std::map<std::string, int> &counts) const
+  {
+    for (auto &stmt : this->statements) {
+      stmt->count_definitions(counts);
+    }
+  }
+  void Do_construct::fold_constants()
+  {
+    constant_folder::fold_expression(this->start_expr);
+    constant_folder::fold_expression(this->end_expr);
+    constant_folder::fold_expression(this->stride_expr);
+    constant_folder::fold_expression(this->trip_count_expr);
+    this->block->fold_constants();
+  }
+  void Do_construct::count_definitions(std::map<std::string, int> &counts) const
+  {
+    counts[this->do_variable->get_var_name()]++;
+    this->block->count_definitions(counts);
+  }
+  void If_construct::fold_constants()
+  {
+    constant_folder::fold_expression(this->condition_expression);
+    this->then_block->fold_constants();
+    this->else_block->fold_constants();
+  }
+  void If_construct::count_definitions(std::map<std::string, int> &counts) const
+  {
+    this->then_block->count_definitions(counts);
+    this->else_block->count_definitions(counts);
+  }
+  void Where_construct::fold_constants()
+  {
+    for (auto &clause : this->clauses) {
+      if (clause.mask) constant_folder::fold_expression(clause.mask);
+      for (auto &assignment : clause.assignments) {
+        assignment->fold_constants();
+      }
+    }
+  }
+  void Where_construct::count_definitions(std::map<std::string, int> &counts) const
+  {
+    for (auto &clause : this->clauses) {
+      for (auto &assignment : clause.assignments) {
+        assignment->count_definitions(counts);
+      }
+    }
+  }
+  void Program_unit::fold_constants()
+  {
+    for (auto &var : *this->variables) {
+      if (var.second->is_array()) var.second->get_shape().fold_constants();
+    }
+    std::map<std::string, int> counts;
+    for (auto &stmt : this->statements) {
+      stmt->count_definitions(counts);
+    }
+    for (auto &internal_program : this->internal_programs) {
+      for (auto &name : internal_program->get_host_definitions()) {
+        counts[name]++;
+      }
+    }
+    // the host is folded first, so its DATA values are known to be read-only
+    for (auto &var : this->host_variables) {
+      if (var->is_read_only() && !var->is_array()) {
+        const Expression *value = var->get_initial_value(0);
+        constant_table[var->get_name()] = value ? value->get_copy() : constant_folder::make_zero(var->get_type_kind());
+      }
+    }
+    // DATA values that are never overwritten
+    for (auto &var : *this->variables) {
+      if (!var.second->has_initial_values() || counts.count(var.first)) continue;
+      var.second->set_read_only();
+      if (!var.second->is_array()) {
+        const Expression *value = var.second->get_initial_value(0);
+        constant_table[var.first] = value ? value->get_copy() : constant_folder::make_zero(var.second->get_type_kind());
+      }
+    }
+    // a definition at the top level is executed before every statement after it,
+    // so those can use the value
+    for (auto &stmt : this->statements) {
+      stmt->fold_constants();
+      if (auto *assignment = dynamic_cast<Assignment_statement*>(stmt.get())) {
+        assignment->propagate_constant(counts);
+      }
+    }
+    // the values belong to this program unit
+    for (auto &program : this->internal_programs) {
+      constant_table.clear();
+      program->fold_constants();
+    }
+    for (auto &program : this->external_programs) {
+      constant_table.clear();
+      program->fold_constants();
+    }
+  }
+}
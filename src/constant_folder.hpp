@@ -0,0 +1,8 @@
+#pragma once
+#include "ast.hpp"
+
+namespace constant_folder {
+  void fold(const std::shared_ptr<ast::Program_unit> program);
+  // replaces expr by its value when it is constant, also used for the named constants
+  void fold_expression(std::unique_ptr<ast::Expression> &expr);
+}
@@ -3,14 +3,41 @@
 #include <typeinfo>
 
 namespace cst {
-  void Program::print() const
+  void Program::print(std::string indent) const
   {
-    std::cout << this->name << std::endl;
+    std::cout << indent;
+    if (this->kind == Program_kind::subroutine) {
+      std::cout << "subroutine ";
+    } else if (this->kind == Program_kind::function) {
+      std::cout << "function ";
+    }
+    std::cout << this->name;
+    if (this->kind != Program_kind::main_program) {
+      std::cout << "(";
+      for (int i=0; i<this->dummy_arguments.size(); i++) {
+        if (i) std::cout << ", ";
+        std::cout << this->dummy_arguments[i];
+      }
+      std::cout << ")";
+    }
+    if (this->kind == Program_kind::function) {
+      std::cout << " result(" << this->result_name << ")";
+    }
+    std::cout << std::endl;
     for (int i=0; i<this->specifications.size(); i++) {
-      this->specifications[i]->print("  ");
+      this->specifications[i]->print(indent + "  ");
     }
     for (int i=0; i<this->executable_constructs.size(); i++) {
-      this->executable_constructs[i]->print("  ");
+      this->executable_constructs[i]->print(indent + "  ");
+    }
+    if (this->internal_subprograms.size() >= 1) {
+      std::cout << indent << "contains" << std::endl;
+      for (auto &subprogram : this->internal_subprograms) {
+        subprogram->print(indent + "  ");
+      }
+    }
+    for (auto &subprogram : this->external_subprograms) {
+      subprogram->print(indent);
     }
   }
 
@@ -46,7 +73,18 @@ namespace cst {
   {
     std::cout << indent;
     if (this->type_kind == Type_kind::Intrinsic) {
-      std::cout << this->type_name << ": ";
+      std::cout << this->type_name;
+      if (this->kind_param) {
+        std::cout << "(" << this->kind_param << ")";
+      }
+      std::cout << ": ";
+    }
+    if (this->parameter_attr) {
+      std::cout << "parameter" << std::endl;
+      for (auto &def : this->named_constants) {
+        def->print(indent + "  ");
+      }
+      return;
     }
     std::cout << this->variables[0];
     for (int i=1; i<this->variables.size(); i++) {
@@ -55,6 +93,45 @@ namespace cst {
     std::cout << std::endl;
   }
 
+  void Named_constant_definition::print(std::string indent) const
+  {
+    std::cout << indent << this->named_constant << " = ";
+    this->expr->print();
+    std::cout << std::endl;
+  }
+
+  void Data_statement_set::print(std::string indent) const
+  {
+    std::cout << indent;
+    for (int i=0; i<this->objects.size(); i++) {
+      if (i) std::cout << ", ";
+      this->objects[i]->print();
+    }
+    std::cout << " /";
+    for (int i=0; i<this->values.size(); i++) {
+      if (i) std::cout << ", ";
+      if (this->repeats[i] != 1) std::cout << this->repeats[i] << "*";
+      this->values[i]->print();
+    }
+    std::cout << "/" << std::endl;
+  }
+
+  void Data_statement::print(std::string indent) const
+  {
+    std::cout << indent << "data statement:" << std::endl;
+    for (auto &set : this->sets) {
+      set->print(indent + "  ");
+    }
+  }
+
+  void Parameter_statement::print(std::string indent) const
+  {
+    std::cout << indent << "parameter statement:" << std::endl;
+    for (auto &def : this->named_constants) {
+      def->print(indent + "  ");
+    }
+  }
+
   void Assignment_statement::print(std::string indent) const
   {
     std::cout << indent << "assignment statement:" << std::endl;
@@ -73,17 +150,52 @@ namespace cst {
   void Array_element::print() const
   {
     std::cout << this->name << "(";
-    this->subscripts[0]->print();
-    for (int i=1; i<this->subscripts.size(); i++) {
-      std::cout << ", ";
+    for (int i=0; i<this->subscripts.size(); i++) {
+      if (i) std::cout << ", ";
       this->subscripts[i]->print();
     }
     std::cout << ")";
   }
+  void Subscript_triplet::print() const
+  {
+    if (this->lower) this->lower->print();
+    std::cout << ":";
+    if (this->upper) this->upper->print();
+    if (this->stride) {
+      std::cout << ":";
+      this->stride->print();
+    }
+  }
   void Constant::print() const
   {
     std::cout << this->value;
   }
+  void Array_constructor::print() const
+  {
+    std::cout << "[";
+    for (int i=0; i<this->values.size(); i++) {
+      if (i) std::cout << ", ";
+      this->values[i]->print();
+    }
+    std::cout << "]";
+  }
+  void Implied_do::print() const
+  {
+    std::cout << "(";
+    for (auto &value : this->values) {
+      value->print();
+      std::cout << ", ";
+    }
+    std::cout << this->do_variable << "=";
+    this->start_expr->print();
+    std::cout << ",";
+    this->end_expr->print();
+    if (this->stride_expr) {
+      std::cout << ",";
+      this->stride_expr->print();
+    }
+    std::cout << ")";
+  }
   void Operator::print() const
   {
     std::cout << "(";
@@ -110,6 +222,34 @@ namespace cst {
     std::cout << ")" << std::endl;
     action_stmt->print(indent + "  ");
   }
+  void Call_statement::print(std::string indent) const
+  {
+    std::cout << indent << "CALL statement: " << this->name << "(";
+    for (int i=0; i<this->args.size(); i++) {
+      if (i) std::cout << ", ";
+      this->args[i]->print();
+    }
+    std::cout << ")" << std::endl;
+  }
+  void Return_statement::print(std::string indent) const
+  {
+    std::cout << indent << "RETURN statement" << std::endl;
+  }
+  void Where_construct::print(std::string indent) const
+  {
+    for (int i=0; i<this->masks.size(); i++) {
+      std::cout << indent << (i == 0 ? "WHERE construct: " : "ELSEWHERE: ");
+      if (this->masks[i]) {
+        std::cout << "(";
+        this->masks[i]->print();
+        std::cout << ")";
+      }
+      std::cout << std::endl;
+      for (auto &assignment : this->assignments[i]) {
+        assignment->print(indent + "  ");
+      }
+    }
+  }
   void Block::print(std::string indent) const
   {
     for (auto& construct : this->execution_part_constructs) {
@@ -3,6 +3,7 @@
 #include <vector>
 #include <memory>
 #include "ast.hpp"
+#include "option.hpp"
 
 namespace cst {
 
@@ -12,6 +13,8 @@ namespace cst {
   public:
     virtual void print() const = 0;
     virtual std::unique_ptr<ast::Expression> ASTgen() const = 0;
+    // appends the values, array constructors and implied-DOs give several
+    virtual void ASTgen_list(std::vector<std::unique_ptr<ast::Expression>> &values) const {values.push_back(ASTgen());}
   };
 
   class Operator : public Expression {
@@ -98,28 +101,68 @@ namespace cst {
     std::vector<std::unique_ptr<Dimension_spec>> specs;
   };
 
+  class Named_constant_definition {
+  public:
+    Named_constant_definition(std::string name, std::unique_ptr<Expression> expr)
+      : named_constant(name), expr(std::move(expr)) {}
+    void print(std::string indent) const;
+    void ASTgen() const;
+  private:
+    std::string named_constant;
+    std::unique_ptr<Expression> expr;
+  };
+
   class Type_specification : public Specification {
   public:
     void print(std::string indent) const;
     void ASTgen(std::shared_ptr<ast::Program_unit> program) const;
-    Type_specification(enum Type_kind kind, std::string name, std::unique_ptr<Expression> len=nullptr) : type_kind(kind), type_name(name), len(std::move(len)) {};
+    Type_specification(enum Type_kind kind, std::string name, std::unique_ptr<Expression> len=nullptr, int kind_param=0) : type_kind(kind), type_name(name), len(std::move(len)), kind_param(kind_param) {};
     void add_variable(std::string var) {variables.push_back(var);}
+    void set_parameter_attr() {parameter_attr = true;}
+    bool has_parameter_attr() const {return parameter_attr;}
+    void add_named_constant(std::unique_ptr<Named_constant_definition> def) {named_constants.push_back(std::move(def));}
   private:
     std::unique_ptr<Expression> len;
+    int kind_param; // 0 is the default kind
     enum Type_kind type_kind;
     std::string type_name;
     std::vector<std::string> variables;
+    bool parameter_attr = false;
+    std::vector<std::unique_ptr<Named_constant_definition>> named_constants;
   };
 
-  class Named_constant_definition {
+  class Parameter_statement : public Specification {
+  public:
+    void print(std::string indent) const;
+    void ASTgen(std::shared_ptr<ast::Program_unit> program) const;
+    void add_named_constant(std::unique_ptr<Named_constant_definition> def) {named_constants.push_back(std::move(def));}
   private:
-    std::string named_constant;
-    //  Expression exp;
+    std::vector<std::unique_ptr<Named_constant_definition>> named_constants;
   };
 
-  class Parameter_statement : public Specification {
+  // object-list / [repeat*] value-list /
+  class Data_statement_set {
+  public:
+    void add_object(std::unique_ptr<Expression> object) {objects.push_back(std::move(object));}
+    void add_value(int64_t repeat, std::unique_ptr<Expression> value) {
+      repeats.push_back(repeat);
+      values.push_back(std::move(value));
+    }
+    void print(std::string indent) const;
+    void ASTgen() const;
   private:
-    std::vector<Named_constant_definition> named_constants;
+    std::vector<std::unique_ptr<Expression>> objects;
+    std::vector<int64_t> repeats;
+    std::vector<std::unique_ptr<Expression>> values;
+  };
+
+  class Data_statement : public Specification {
+  public:
+    void print(std::string indent) const;
+    void ASTgen(std::shared_ptr<ast::Program_unit> program) const;
+    void add_set(std::unique_ptr<Data_statement_set> set) {sets.push_back(std::move(set));}
+  private:
+    std::vector<std::unique_ptr<Data_statement_set>> sets;
   };
 
   class Executable_construct {
@@ -169,7 +212,9 @@ namespace cst {
     Variable(std::string name) : name(name) {};
     virtual void print() const;
     virtual std::unique_ptr<ast::Expression> ASTgen() const;
-    virtual std::unique_ptr<ast::Variable_definition> ASTgen_definition() const;
+    // is_defined is false for an actual argument of a function, whose storage is passed but not defined
+    virtual std::unique_ptr<ast::Variable_definition> ASTgen_definition(bool is_defined = true) const;
+    std::string get_name() const {return name;}
   protected:
     std::string name;
   };
@@ -180,9 +225,31 @@ namespace cst {
       : Variable(name), subscripts(std::move(subscripts)) {}
     void print() const;
     std::unique_ptr<ast::Expression> ASTgen() const;
-    std::unique_ptr<ast::Variable_definition> ASTgen_definition() const;
+    std::unique_ptr<ast::Variable_definition> ASTgen_definition(bool is_defined = true) const;
+    void set_line_num(int line_num) {this->line_num = line_num;}
   private:
     std::vector<std::unique_ptr<Expression>> subscripts;
+    int line_num = 0; // for bounds checking
+    bool is_section() const;
+    std::vector<ast::Section_subscript> ASTgen_section_subscripts(const ast::Shape &shape) const;
+  };
+
+  // [lower] : [upper] [: stride] in the subscripts of an array section
+  class Subscript_triplet : public Expression {
+  public:
+    Subscript_triplet(std::unique_ptr<Expression> lower, std::unique_ptr<Expression> upper,
+                      std::unique_ptr<Expression> stride)
+      : lower(std::move(lower)), upper(std::move(upper)), stride(std::move(stride)) {}
+    void print() const;
+    std::unique_ptr<ast::Expression> ASTgen() const;
+    // nullptr when omitted
+    const Expression *get_lower() const {return lower.get();}
+    const Expression *get_upper() const {return upper.get();}
+    const Expression *get_stride() const {return stride.get();}
+  private:
+    std::unique_ptr<Expression> lower;
+    std::unique_ptr<Expression> upper;
+    std::unique_ptr<Expression> stride;
   };
 
   class Constant : public Expression {
@@ -190,21 +257,56 @@ namespace cst {
     void print() const;
     Constant(enum Type_kind kind, std::string name, std::string value) : type_kind(kind), type_name(name), value(value) {};
     std::unique_ptr<ast::Expression> ASTgen() const;
+    void negate() {value = "-" + value;}
   private:
     enum Type_kind type_kind;
     std::string type_name;
     std::string value;
   };
 
-  
+  // [ ac-value-list ] or (/ ac-value-list /), the values are flattened
+  class Array_constructor : public Expression {
+  public:
+    void print() const;
+    std::unique_ptr<ast::Expression> ASTgen() const;
+    void ASTgen_list(std::vector<std::unique_ptr<ast::Expression>> &values) const;
+    void add_value(std::unique_ptr<Expression> value) {values.push_back(std::move(value));}
+  private:
+    std::vector<std::unique_ptr<Expression>> values;
+  };
+
+  // ( value-list, do-variable = start, end [, stride] ) in array constructors and DATA statements
+  class Implied_do : public Expression {
+  public:
+    Implied_do(std::vector<std::unique_ptr<Expression>> values, std::string do_variable,
+               std::unique_ptr<Expression> start_expr,
+               std::unique_ptr<Expression> end_expr,
+               std::unique_ptr<Expression> stride_expr)
+      : values(std::move(values)), do_variable(do_variable), start_expr(std::move(start_expr)),
+        end_expr(std::move(end_expr)), stride_expr(std::move(stride_expr)) {}
+    void print() const;
+    std::unique_ptr<ast::Expression> ASTgen() const;
+    void ASTgen_list(std::vector<std::unique_ptr<ast::Expression>> &values) const;
+  private:
+    std::vector<std::unique_ptr<Expression>> values;
+    std::string do_variable;
+    std::unique_ptr<Expression> start_expr;
+    std::unique_ptr<Expression> end_expr;
+    std::unique_ptr<Expression> stride_expr;
+  };
+
   class Do_construct : public Executable_construct {
   public:
     Do_construct(std::string name) : construct_name(name) {}
     virtual void print(std::string indent) const = 0;
     void set_block(std::unique_ptr<Block> block) {this->block = std::move(block);}
     std::string get_construct_name() {return construct_name;}
+    void set_line_num(int line_num) {this->line_num = line_num;}
+    void set_directives(const ast::Loop_directives &directives) {this->directives = directives;}
   protected:
     std::string construct_name;
+    int line_num = 0; // for optimization reports
+    ast::Loop_directives directives;
     std::unique_ptr<Block> block;
   };
 
@@ -242,23 +344,76 @@ namespace cst {
     std::unique_ptr<Expression> rhs;
   };
 
-  class Subroutine {
+  // WHERE ( mask ) ... [ELSEWHERE [( mask )] ...] END WHERE, a where-stmt has one assignment
+  class Where_construct : public Executable_construct {
+  public:
+    void print(std::string indent) const;
+    std::unique_ptr<ast::Statement> ASTgen() const;
+    void add_clause(std::unique_ptr<Expression> mask) {
+      masks.push_back(std::move(mask));
+      assignments.emplace_back();
+    }
+    void add_assignment(std::unique_ptr<Assignment_statement> stmt) {assignments.back().push_back(std::move(stmt));}
+    bool has_mask() const {return masks.back() != nullptr;}
+  private:
+    std::vector<std::unique_ptr<Expression>> masks; // nullptr for an ELSEWHERE without a mask
+    std::vector<std::vector<std::unique_ptr<Assignment_statement>>> assignments;
+  };
+
+  // CALL name [( actual-args )], the arguments are passed by reference
+  class Call_statement : public Executable_construct {
+  public:
+    Call_statement(std::string name, std::vector<std::unique_ptr<Expression>> args, int line_num)
+      : name(name), args(std::move(args)), line_num(line_num) {}
+    void print(std::string indent) const;
+    std::unique_ptr<ast::Statement> ASTgen() const;
+  private:
+    std::string name;
+    std::vector<std::unique_ptr<Expression>> args;
+    int line_num; // for optimization reports
+  };
+
+  class Return_statement : public Executable_construct {
+  public:
+    void print(std::string indent) const;
+    std::unique_ptr<ast::Statement> ASTgen() const;
+  };
 
+  enum class Program_kind : int {
+    main_program,
+    subroutine,
+    function
   };
 
+  // a main program or a subprogram. The internal subprograms follow CONTAINS,
+  // the main program also keeps the external subprograms of the file
   class Program {
   public:
-    Program(std::string str) { name = str; };
-    void print() const;
-    std::shared_ptr<ast::Program_unit> ASTgen() const;
+    Program(std::string str, Program_kind kind = Program_kind::main_program) : name(str), kind(kind) {}
+    void print(std::string indent = "") const;
+    std::shared_ptr<ast::Program_unit> ASTgen(const Compile_options &opts) const;
     void add_specification(std::unique_ptr<Specification> spec) {specifications.push_back(std::move(spec));};
     void add_executable_construct(std::unique_ptr<Executable_construct> exec) {executable_constructs.push_back(std::move(exec));};
-    std::string get_name() { return name; }
+    std::string get_name() const { return name; }
+    Program_kind get_kind() const {return kind;}
+    void add_dummy_argument(std::string name) {dummy_arguments.push_back(name);}
+    // the variable holding the value of a function
+    void set_result_name(std::string name) {result_name = name;}
+    void add_internal_subprogram(std::unique_ptr<Program> subprogram) {internal_subprograms.push_back(std::move(subprogram));}
+    void add_external_subprogram(std::unique_ptr<Program> subprogram) {external_subprograms.push_back(std::move(subprogram));}
+    const std::vector<std::unique_ptr<Program>> &get_internal_subprograms() const {return internal_subprograms;}
+    const std::vector<std::unique_ptr<Program>> &get_external_subprograms() const {return external_subprograms;}
+    // the analysis is done in phases, see semantic_analysis.cpp
+    void ASTgen_specification_part() const;
+    void ASTgen_execution_part() const;
   private:
-    std::string name;
-    //  int program_kind; // enum
+    std::string name; // empty when the file has only subprograms
+    Program_kind kind;
+    std::vector<std::string> dummy_arguments;
+    std::string result_name;
     std::vector<std::unique_ptr<Specification>> specifications;
     std::vector<std::unique_ptr<Executable_construct>> executable_constructs;
-    Subroutine subroutines_head;
+    std::vector<std::unique_ptr<Program>> internal_subprograms;
+    std::vector<std::unique_ptr<Program>> external_subprograms;
   };
 }
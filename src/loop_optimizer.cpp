@@ -0,0 +1,671 @@
+#include "loop_optimizer.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+
+/* AST -> AST transformations of DO loops, done before IR generation */
+
+static Compile_options options;
+static std::string source_name;
+static ast::Program_unit *current_program_unit;
+// the cache model used to size loop tiles
+static const int64_t cache_line_size = 64;
+
+namespace loop_optimizer {
+  // direction of a dependence in one loop, in iterations from the first access to the second
+  enum class Direction {
+    lt, eq, gt, any
+  };
+
+  // a perfect nest of rectangular loops, all of which run at least once,
+  // whose body only defines array elements
+  struct Loop_nest {
+    std::vector<ast::Do_construct*> loops; // outermost first
+    std::vector<std::string> vars;
+    std::vector<int64_t> strides;
+    std::vector<int64_t> trip_counts;
+    std::vector<const ast::Array_element_reference*> elements;
+    std::vector<bool> is_write;
+    std::vector<std::vector<Direction>> dependences;
+  };
+
+  void report(int line_num, std::string message) {
+    if (options.opt_info) {
+      std::cerr << source_name << ":" << line_num << ": optimized: " << message << std::endl;
+    }
+  }
+  // direction vector of the dependence between two accesses of the same array.
+  // each subscript is solved separately, a(c*v+k1) and a(c*v+k2) meet at the distance (k1-k2)/c in v.
+  // returns false when the accesses never touch the same element
+  bool get_dependence(const ast::Array_element_reference &first,
+                      const ast::Array_element_reference &second,
+                      const std::vector<std::string> &loop_vars,
+                      const std::vector<int64_t> &loop_strides,
+                      std::vector<Direction> &directions) {
+    std::map<std::string, int64_t> distances;
+    std::set<std::string> unknown;
+    bool all_unknown = false;
+    auto is_loop_var = [&](const std::string &name) {
+      return std::find(loop_vars.begin(), loop_vars.end(), name) != loop_vars.end();
+    };
+    for (size_t dim = 0; dim < first.get_indices().size(); dim++) {
+      ast::Affine_form f, s;
+      if (!first.get_indices()[dim]->get_affine_form(f) ||
+          !second.get_indices()[dim]->get_affine_form(s)) {
+        all_unknown = true;
+        continue;
+      }
+      // loop invariant terms have to cancel out
+      bool invariant_equal = true;
+      std::set<std::string> vars;
+      for (auto *form : {&f, &s}) {
+        for (auto &term : form->coeffs) {
+          if (term.second == 0) continue;
+          if (is_loop_var(term.first)) {
+            vars.insert(term.first);
+          } else if (f.coeffs[term.first] != s.coeffs[term.first]) {
+            invariant_equal = false;
+          }
+        }
+      }
+      if (!invariant_equal) {
+        unknown.insert(vars.begin(), vars.end());
+        continue;
+      }
+      if (vars.empty()) {
+        if (f.constant != s.constant) return false;
+        continue;
+      }
+      std::string var = *vars.begin();
+      if (vars.size() != 1 || f.coeffs[var] != s.coeffs[var]) {
+        unknown.insert(vars.begin(), vars.end());
+        continue;
+      }
+      int64_t diff = f.constant - s.constant;
+      if (diff % f.coeffs[var] != 0) return false;
+      int64_t distance = diff / f.coeffs[var];
+      if (distances.count(var) && distances[var] != distance) return false;
+      distances[var] = distance;
+    }
+
+    directions.clear();
+    for (size_t i = 0; i < loop_vars.size(); i++) {
+      const std::string &var = loop_vars[i];
+      if (all_unknown || unknown.count(var) || !distances.count(var)) {
+        directions.push_back(Direction::any);
+        continue;
+      }
+      if (distances[var] % loop_strides[i] != 0) return false;
+      int64_t iterations = distances[var] / loop_strides[i];
+      directions.push_back(iterations > 0 ? Direction::lt : iterations < 0 ? Direction::gt : Direction::eq);
+    }
+    return true;
+  }
+  // calls check(signs) for every expansion of the '*' entries until it returns false
+  bool for_each_expansion(const std::vector<Direction> &directions,
+                          std::function<bool(const std::vector<int> &)> check) {
+    int combinations = 1;
+    for (auto direction : directions) {
+      if (direction == Direction::any) combinations *= 3;
+    }
+    for (int n = 0; n < combinations; n++) {
+      std::vector<int> signs;
+      int rest = n;
+      for (auto direction : directions) {
+        switch (direction) {
+        case Direction::lt: signs.push_back(1); break;
+        case Direction::eq: signs.push_back(0); break;
+        case Direction::gt: signs.push_back(-1); break;
+        case Direction::any: signs.push_back(rest % 3 - 1); rest /= 3; break;
+        }
+      }
+      if (!check(signs)) return false;
+    }
+    return true;
+  }
+  // a loop order keeps a dependence when the outermost loop carrying it
+  // runs in the same direction as before
+  bool is_legal_order(const std::vector<std::vector<Direction>> &dependences, const std::vector<int> &order) {
+    for (auto &directions : dependences) {
+      bool legal = for_each_expansion(directions, [&](const std::vector<int> &signs) {
+          int before = 0, after = 0;
+          for (size_t i = 0; i < signs.size() && !before; i++) before = signs[i];
+          for (size_t i = 0; i < signs.size() && !after; i++) after = signs[order[i]];
+          return before == after;
+        });
+      if (!legal) return false;
+    }
+    return true;
+  }
+  // tiling reorders iterations freely within a tile, which is legal
+  // when no dependence goes backwards in any of the loops
+  bool is_fully_permutable(const std::vector<std::vector<Direction>> &dependences) {
+    for (auto &directions : dependences) {
+      bool legal = for_each_expansion(directions, [&](const std::vector<int> &signs) {
+          bool forward = false, backward = false;
+          for (int sign : signs) {
+            forward |= sign > 0;
+            backward |= sign < 0;
+          }
+          return !(forward && backward);
+        });
+      if (!legal) return false;
+    }
+    return true;
+  }
+  int64_t get_element_size(ast::Type_kind kind) {
+    switch (kind) {
+    case ast::Type_kind::i64:
+    case ast::Type_kind::fp64:
+      return 8;
+    case ast::Type_kind::character:
+      return 1;
+    default:
+      return 4;
+    }
+  }
+  // bytes of the cache lines touched by one tile, extents[i] iterations of each loop.
+  // along the loop with the smallest memory stride neighbouring elements share lines,
+  // along the other loops every step is taken to be a new line
+  uint64_t get_footprint(const Loop_nest &nest, const std::vector<int64_t> &extents) {
+    uint64_t bytes = 0;
+    for (auto *element : nest.elements) {
+      ast::Affine_form offset;
+      if (!element->get_offset_expr().get_affine_form(offset)) continue;
+      int64_t elm_size = get_element_size(element->get_type_kind());
+      int smallest = -1;
+      int64_t smallest_stride = 0;
+      uint64_t lines = 1;
+      for (size_t i = 0; i < nest.loops.size(); i++) {
+        int64_t stride = std::abs(offset.coeffs[nest.vars[i]] * nest.strides[i]) * elm_size;
+        if (stride == 0) continue;
+        if (smallest < 0 || stride < smallest_stride) {
+          if (smallest >= 0) lines *= extents[smallest];
+          smallest = i;
+          smallest_stride = stride;
+        } else {
+          lines *= extents[i];
+        }
+      }
+      if (smallest >= 0) {
+        lines *= (extents[smallest] * smallest_stride + cache_line_size - 1) / cache_line_size;
+      }
+      bytes += lines * cache_line_size;
+    }
+    return bytes;
+  }
+  // tiling pays off when the nest does not fit in the cache and the data brought in
+  // by the inner loops is used again later: either an array walked with a large
+  // stride by the innermost loop, or one reused across an outer loop it doesn't depend on
+  bool has_tiling_reuse(const Loop_nest &nest) {
+    if (get_footprint(nest, nest.trip_counts) <= options.tile_cache_size) return false;
+    int innermost = nest.loops.size() - 1;
+    for (auto *element : nest.elements) {
+      ast::Affine_form offset;
+      if (!element->get_offset_expr().get_affine_form(offset)) continue;
+      int64_t inner_coeff = std::abs(offset.coeffs[nest.vars[innermost]]);
+      if (inner_coeff == 0) continue;
+      if (inner_coeff * get_element_size(element->get_type_kind()) >= cache_line_size) return true;
+      for (int i = 0; i < innermost; i++) {
+        if (offset.coeffs[nest.vars[i]] == 0) return true;
+      }
+    }
+    return false;
+  }
+  // the largest power of two tile whose footprint takes at most half of the cache,
+  // the rest is left for the data the tile does not reuse
+  int64_t choose_tile_size(const Loop_nest &nest) {
+    for (int64_t size = 1024; size >= 16; size /= 2) {
+      std::vector<int64_t> extents;
+      for (int64_t trip_count : nest.trip_counts) {
+        extents.push_back(std::min(size, trip_count));
+      }
+      if (get_footprint(nest, extents) <= options.tile_cache_size / 2) return size;
+    }
+    return 16;
+  }
+  // fusion runs the second body of an iteration after the first body of the same or an
+  // earlier iteration. no dependence may go from an iteration of the first loop back to
+  // an earlier iteration of the second one
+  bool is_legal_fusion(const std::vector<std::vector<Direction>> &dependences) {
+    for (auto &directions : dependences) {
+      bool legal = for_each_expansion(directions, [&](const std::vector<int> &signs) {
+          for (int sign : signs) {
+            if (sign != 0) return sign > 0;
+          }
+          return true;
+        });
+      if (!legal) return false;
+    }
+    return true;
+  }
+  // the array elements among the accesses. false when a scalar is defined or a whole array is used
+  bool get_element_accesses(const std::vector<ast::Memory_access> &accesses,
+                            std::vector<const ast::Array_element_reference*> &elements,
+                            std::vector<bool> &is_write) {
+    for (auto &access : accesses) {
+      auto *element = dynamic_cast<const ast::Array_element_reference*>(access.ref);
+      if (!element) {
+        if (access.is_write || access.ref->is_array()) return false;
+        continue;
+      }
+      elements.push_back(element);
+      is_write.push_back(access.is_write);
+    }
+    return true;
+  }
+  // the forms differ at most in the constant
+  bool has_same_terms(ast::Affine_form fa, ast::Affine_form fb) {
+    for (auto *form : {&fa, &fb}) {
+      for (auto &term : form->coeffs) {
+        if (fa.coeffs[term.first] != fb.coeffs[term.first]) return false;
+      }
+    }
+    return true;
+  }
+  bool is_same_expression(const ast::Expression &a, const ast::Expression &b) {
+    ast::Affine_form fa, fb;
+    if (!a.get_affine_form(fa) || !b.get_affine_form(fb) || fa.constant != fb.constant) return false;
+    return has_same_terms(fa, fb);
+  }
+  // merges each DO construct with the ones right after it while possible
+  void fuse_adjacent_loops(std::vector<std::unique_ptr<ast::Statement>> &statements) {
+    for (size_t i = 0; i + 1 < statements.size(); ) {
+      auto *first = dynamic_cast<ast::Do_construct*>(statements[i].get());
+      auto *second = dynamic_cast<ast::Do_construct*>(statements[i+1].get());
+      if (first && second && ast::Do_construct::fuse(*first, *second)) {
+        statements.erase(statements.begin() + i + 1);
+      } else {
+        i++;
+      }
+    }
+  }
+  std::unique_ptr<ast::Expression> make_int_constant(ast::Type_kind kind, int64_t value) {
+    if (kind == ast::Type_kind::i64) {
+      return std::make_unique<ast::Int64_constant>(value);
+    }
+    return std::make_unique<ast::Int32_constant>(value);
+  }
+  void optimize(const std::shared_ptr<ast::Program_unit> program, const Compile_options &opts, std::string name) {
+    options = opts;
+    source_name = name;
+    if (options.opt_level < 2) return;
+    program->optimize_loops();
+  }
+}
+
+namespace ast {
+  bool Assignment_statement::collect_accesses(std::vector<Memory_access> &accesses) const
+  {
+    // a function may read host variables, which are not seen here
+    if (this->rhs->has_function_reference()) return false;
+    std::vector<const Variable_reference*> reads;
+    if (auto *element = dynamic_cast<const Array_element_reference*>(this->lhs.get())) {
+      for (auto &index : element->get_indices()) {
+        if (index->has_function_reference()) return false;
+        index->collect_references(reads);
+      }
+    }
+    this->rhs->collect_references(reads);
+    for (auto *ref : reads) {
+      accesses.push_back({ref, false});
+    }
+    accesses.push_back({this->lhs.get(), true});
+    return true;
+  }
+  bool If_construct::collect_accesses(std::vector<Memory_access> &accesses) const
+  {
+    if (this->condition_expression->has_function_reference()) return false;
+    std::vector<const Variable_reference*> reads;
+    this->condition_expression->collect_references(reads);
+    for (auto *ref : reads) {
+      accesses.push_back({ref, false});
+    }
+    return this->then_block->collect_accesses(accesses) && this->else_block->collect_accesses(accesses);
+  }
+  bool Block::collect_accesses(std::vector<Memory_access> &accesses) const
+  {
+    for (auto &stmt : this->statements) {
+      if (!stmt->collect_accesses(accesses)) return false;
+    }
+    return true;
+  }
+  Do_construct *Block::get_single_loop() const
+  {
+    if (this->statements.size() != 1) return nullptr;
+    return dynamic_cast<Do_construct*>(this->statements[0].get());
+  }
+  void Block::append(Block &other)
+  {
+    for (auto &stmt : other.statements) {
+      this->statements.push_back(std::move(stmt));
+    }
+    other.statements.clear();
+  }
+
+  std::vector<Do_construct*> Do_construct::get_perfect_nest()
+  {
+    std::vector<Do_construct*> nest = {this};
+    while (Do_construct *inner = nest.back()->block->get_single_loop()) {
+      nest.push_back(inner);
+    }
+    return nest;
+  }
+  // only rectangular nests whose loops all run at least once are transformed,
+  // then the do-variables end with the same values in any order
+  bool Do_construct::analyze_nest(loop_optimizer::Loop_nest &nest)
+  {
+    nest.loops = this->get_perfect_nest();
+    if (nest.loops.size() < 2) return false;
+
+    for (Do_construct *loop : nest.loops) {
+      if (!loop->stride_expr->is_constant_int() || loop->stride_expr->eval_constant_value() == 0) return false;
+      if (!loop->trip_count_expr->is_constant_int() || loop->trip_count_expr->eval_constant_value() <= 0) return false;
+      nest.vars.push_back(loop->do_variable->get_var_name());
+      nest.strides.push_back(loop->stride_expr->eval_constant_value());
+      nest.trip_counts.push_back(loop->trip_count_expr->eval_constant_value());
+    }
+
+    // the body may only define array elements
+    std::vector<Memory_access> accesses;
+    if (!nest.loops.back()->block->collect_accesses(accesses)) return false;
+    if (!loop_optimizer::get_element_accesses(accesses, nest.elements, nest.is_write)) return false;
+
+    for (size_t w = 0; w < nest.elements.size(); w++) {
+      if (!nest.is_write[w]) continue;
+      for (size_t r = 0; r < nest.elements.size(); r++) {
+        if (nest.elements[r]->get_var_name() != nest.elements[w]->get_var_name()) continue;
+        std::vector<loop_optimizer::Direction> directions;
+        if (loop_optimizer::get_dependence(*nest.elements[w], *nest.elements[r],
+                                           nest.vars, nest.strides, directions)) {
+          nest.dependences.push_back(directions);
+        }
+      }
+    }
+    return true;
+  }
+  // exchanges the loop controls and their directives, the bodies stay where they are
+  void Do_construct::swap_header(Do_construct &other)
+  {
+    std::swap(this->directives, other.directives);
+    std::swap(this->do_variable, other.do_variable);
+    std::swap(this->start_expr, other.start_expr);
+    std::swap(this->end_expr, other.end_expr);
+    std::swap(this->stride_expr, other.stride_expr);
+    std::swap(this->trip_count_expr, other.trip_count_expr);
+  }
+  // arrays are column-major, so the loop walking the smallest stride should be innermost
+  bool Do_construct::interchange_loops()
+  {
+    loop_optimizer::Loop_nest nest;
+    if (!this->analyze_nest(nest)) return false;
+
+    // memory stride of each loop, summed over the array references
+    std::vector<int64_t> costs(nest.loops.size(), 0);
+    for (auto *element : nest.elements) {
+      Affine_form offset;
+      if (!element->get_offset_expr().get_affine_form(offset)) continue;
+      for (size_t i = 0; i < nest.loops.size(); i++) {
+        costs[i] += std::abs(offset.coeffs[nest.vars[i]] * nest.strides[i]);
+      }
+    }
+    int innermost = nest.loops.size() - 1;
+    int best = -1;
+    for (int i = 0; i < nest.loops.size(); i++) {
+      if (costs[i] > 0 && (best < 0 || costs[i] <= costs[best])) best = i;
+    }
+    if (best < 0 || best == innermost) return false;
+
+    std::vector<int> order;
+    for (int i = 0; i < nest.loops.size(); i++) {
+      if (i != best) order.push_back(i);
+    }
+    order.push_back(best);
+    if (!loop_optimizer::is_legal_order(nest.dependences, order)) return false;
+
+    for (int i = best; i < innermost; i++) {
+      nest.loops[i]->swap_header(*nest.loops[i+1]);
+    }
+    std::string new_order;
+    for (int i : order) {
+      new_order += (new_order.empty() ? "" : ", ") + nest.vars[i];
+    }
+    loop_optimizer::report(this->line_num, "loops interchanged, the nest order is now (" + new_order + ")");
+    return true;
+  }
+  // strip-mines the loops of the nest and moves the tile loops outside:
+  //   do v = start, end, stride        do v.tile = 0, (ntiles-1)*size, size
+  //                                =>    do v = start+v.tile*stride, ..., stride  (min(size, trip-v.tile) times)
+  // the tile loop counts iterations, so the element loops together run exactly
+  // the original trip count and leave v with its original final value
+  bool Do_construct::tile_loops()
+  {
+    loop_optimizer::Loop_nest nest;
+    if (!this->analyze_nest(nest)) return false;
+    size_t depth = nest.loops.size();
+
+    // !dir$ block(n) overrides the size from the cache model
+    int64_t model_size = loop_optimizer::has_tiling_reuse(nest) ? loop_optimizer::choose_tile_size(nest) : 0;
+    std::vector<int64_t> sizes(depth);
+    bool tiled = false;
+    for (size_t i = 0; i < depth; i++) {
+      sizes[i] = nest.loops[i]->directives.block_size;
+      if (sizes[i] < 0) sizes[i] = model_size;
+      if (sizes[i] <= 1 || sizes[i] >= nest.trip_counts[i]) sizes[i] = 0;
+      tiled |= sizes[i] > 0;
+    }
+    if (!tiled || !loop_optimizer::is_fully_permutable(nest.dependences)) return false;
+
+    // element loops, from the inside out
+    std::vector<std::shared_ptr<Variable>> tile_vars(depth);
+    std::unique_ptr<Block> body = std::move(nest.loops.back()->block);
+    for (int i = depth - 1; i >= 0; i--) {
+      Do_construct *loop = nest.loops[i];
+      Type_kind kind = loop->do_variable->get_type_kind();
+      std::unique_ptr<Do_construct> element;
+      if (sizes[i] == 0) {
+        element = std::make_unique<Do_construct>(std::move(loop->do_variable),
+                                                 std::move(loop->start_expr),
+                                                 std::move(loop->end_expr),
+                                                 std::move(loop->stride_expr),
+                                                 std::move(loop->trip_count_expr),
+                                                 std::move(body));
+      } else {
+        tile_vars[i] = std::make_shared<Variable>(nest.vars[i] + ".tile");
+        tile_vars[i]->set_type(loop->do_variable->get_type());
+        current_program_unit->add_variable(tile_vars[i]);
+        auto tile_ref = [&]() {return std::make_unique<Variable_reference>(tile_vars[i]);};
+        // start + v.tile*stride
+        auto start = std::make_unique<Binary_op>(binary_op_kind::add,
+                                                 loop->start_expr->get_copy(),
+                                                 std::make_unique<Binary_op>(binary_op_kind::mul,
+                                                                             tile_ref(),
+                                                                             loop->stride_expr->get_copy()));
+        // min(size, trip - v.tile)
+        auto trip_count = std::make_unique<Binary_op>(binary_op_kind::min,
+                                                      loop_optimizer::make_int_constant(kind, sizes[i]),
+                                                      std::make_unique<Binary_op>(binary_op_kind::sub,
+                                                                                  loop_optimizer::make_int_constant(kind, nest.trip_counts[i]),
+                                                                                  tile_ref()));
+        // start + (v.tile + trip - 1)*stride
+        auto last = std::make_unique<Binary_op>(binary_op_kind::sub,
+                                                std::make_unique<Binary_op>(binary_op_kind::add,
+                                                                            tile_ref(),
+                                                                            trip_count->get_copy()),
+                                                loop_optimizer::make_int_constant(kind, 1));
+        auto end = std::make_unique<Binary_op>(binary_op_kind::add,
+                                               loop->start_expr->get_copy(),
+                                               std::make_unique<Binary_op>(binary_op_kind::mul,
+                                                                           std::move(last),
+                                                                           loop->stride_expr->get_copy()));
+        element = std::make_unique<Do_construct>(std::move(loop->do_variable),
+                                                 std::move(start),
+                                                 std::move(end),
+                                                 std::move(loop->stride_expr),
+                                                 std::move(trip_count),
+                                                 std::move(body));
+      }
+      element->line_num = loop->line_num;
+      element->directives = loop->directives;
+      body = std::make_unique<Block>();
+      body->add_statement(std::move(element));
+    }
+
+    // tile loops, from the inside out. this becomes the outermost one
+    std::string report;
+    for (int i = depth - 1; i >= 0; i--) {
+      if (sizes[i] == 0) continue;
+      Type_kind kind = tile_vars[i]->get_type_kind();
+      int64_t tile_count = (nest.trip_counts[i] + sizes[i] - 1) / sizes[i];
+      auto tile_loop = std::make_unique<Do_construct>(std::make_unique<Variable_definition>(tile_vars[i]),
+                                                      loop_optimizer::make_int_constant(kind, 0),
+                                                      loop_optimizer::make_int_constant(kind, (tile_count - 1) * sizes[i]),
+                                                      loop_optimizer::make_int_constant(kind, sizes[i]),
+                                                      loop_optimizer::make_int_constant(kind, tile_count),
+                                                      std::move(body));
+      report = nest.vars[i] + " by " + std::to_string(sizes[i]) + (report.empty() ? "" : ", ") + report;
+      bool outermost = std::none_of(sizes.begin(), sizes.begin() + i, [](int64_t size) {return size > 0;});
+      if (outermost) {
+        this->swap_header(*tile_loop);
+        this->block = std::move(tile_loop->block);
+        break;
+      }
+      tile_loop->line_num = nest.loops[i]->line_num;
+      body = std::make_unique<Block>();
+      body->add_statement(std::move(tile_loop));
+    }
+    loop_optimizer::report(this->line_num, "loop nest tiled, " + report);
+    return true;
+  }
+  // nests of the same depth whose loops have the same do-variables and bounds run the
+  // same iterations. the body of second is appended to the body of first
+  bool Do_construct::fuse(Do_construct &first, Do_construct &second)
+  {
+    std::vector<Do_construct*> first_nest = first.get_perfect_nest();
+    std::vector<Do_construct*> second_nest = second.get_perfect_nest();
+    if (first_nest.size() != second_nest.size()) return false;
+
+    std::vector<std::string> vars;
+    std::vector<int64_t> strides;
+    for (size_t i = 0; i < first_nest.size(); i++) {
+      Do_construct *a = first_nest[i];
+      Do_construct *b = second_nest[i];
+      if (a->do_variable->get_var_name() != b->do_variable->get_var_name()) return false;
+      // the hints were given for one body, not for the fused one
+      if (a->directives.has_codegen_hints() || b->directives.has_codegen_hints()) return false;
+      if (!a->stride_expr->is_constant_int() || a->stride_expr->eval_constant_value() == 0) return false;
+      if (!loop_optimizer::is_same_expression(*a->start_expr, *b->start_expr) ||
+          !loop_optimizer::is_same_expression(*a->end_expr, *b->end_expr) ||
+          !loop_optimizer::is_same_expression(*a->stride_expr, *b->stride_expr)) {
+        return false;
+      }
+      vars.push_back(a->do_variable->get_var_name());
+      strides.push_back(a->stride_expr->eval_constant_value());
+    }
+
+    // the bodies define no scalar, so the bounds of second are not changed by first
+    std::vector<Memory_access> first_accesses, second_accesses;
+    std::vector<const Array_element_reference*> first_elements, second_elements;
+    std::vector<bool> first_is_write, second_is_write;
+    if (!first_nest.back()->block->collect_accesses(first_accesses) ||
+        !second_nest.back()->block->collect_accesses(second_accesses) ||
+        !loop_optimizer::get_element_accesses(first_accesses, first_elements, first_is_write) ||
+        !loop_optimizer::get_element_accesses(second_accesses, second_elements, second_is_write)) {
+      return false;
+    }
+    std::vector<std::vector<loop_optimizer::Direction>> dependences;
+    for (size_t f = 0; f < first_elements.size(); f++) {
+      for (size_t s = 0; s < second_elements.size(); s++) {
+        if (!first_is_write[f] && !second_is_write[s]) continue;
+        if (first_elements[f]->get_var_name() != second_elements[s]->get_var_name()) continue;
+        std::vector<loop_optimizer::Direction> directions;
+        if (loop_optimizer::get_dependence(*first_elements[f], *second_elements[s], vars, strides, directions)) {
+          dependences.push_back(directions);
+        }
+      }
+    }
+    if (!loop_optimizer::is_legal_fusion(dependences)) return false;
+
+    first_nest.back()->block->append(*second_nest.back()->block);
+    loop_optimizer::report(first.line_num, "loop fused with the loop at line " + std::to_string(second.line_num));
+    return true;
+  }
+  // finds the array streams of an innermost loop the hardware prefetcher is not
+  // expected to follow, those stepping over more than a cache line per iteration
+  // and those walking an array larger than the last level cache
+  void Do_construct::plan_prefetches()
+  {
+    this->prefetch_streams.clear();
+    std::vector<Memory_access> accesses;
+    if (!this->stride_expr->is_constant_int() || !this->block->collect_accesses(accesses)) return;
+    std::string var = this->do_variable->get_var_name();
+    int64_t stride = this->stride_expr->eval_constant_value();
+    std::vector<Affine_form> offsets;
+    for (auto &access : accesses) {
+      auto *element = dynamic_cast<const Array_element_reference*>(access.ref);
+      Affine_form offset;
+      if (!element || !element->get_offset_expr().get_affine_form(offset)) continue;
+      int64_t step = offset.coeffs[var] * stride;
+      int64_t elm_size = loop_optimizer::get_element_size(element->get_type_kind());
+      uint64_t array_size = element->get_shape().get_storage_size() * elm_size;
+      if (step == 0 ||
+          (std::abs(step) * elm_size <= cache_line_size && array_size <= options.llc_size)) {
+        continue;
+      }
+      // a reference within a cache line of a known stream is covered by its prefetches
+      bool covered = false;
+      for (size_t i = 0; i < offsets.size() && !covered; i++) {
+        if (this->prefetch_streams[i].ref->get_var_name() == element->get_var_name() &&
+            loop_optimizer::has_same_terms(offsets[i], offset) &&
+            std::abs(offsets[i].constant - offset.constant) * elm_size < cache_line_size) {
+          this->prefetch_streams[i].is_write |= access.is_write;
+          covered = true;
+        }
+      }
+      if (covered) continue;
+      this->prefetch_streams.push_back({element, step, access.is_write});
+      offsets.push_back(offset);
+    }
+    if (!this->prefetch_streams.empty()) {
+      loop_optimizer::report(this->line_num, "array streams prefetched: " +
+                             std::to_string(this->prefetch_streams.size()));
+    }
+  }
+  void Do_construct::optimize_loops()
+  {
+    this->interchange_loops();
+    if (this->tile_loops()) {
+      if (options.prefetch_loop_arrays) this->get_perfect_nest().back()->plan_prefetches();
+      return;
+    }
+    this->block->optimize_loops();
+    if (options.prefetch_loop_arrays) this->plan_prefetches();
+  }
+  void If_construct::optimize_loops()
+  {
+    this->then_block->optimize_loops();
+    this->else_block->optimize_loops();
+  }
+  void Block::optimize_loops()
+  {
+    loop_optimizer::fuse_adjacent_loops(this->statements);
+    for (auto &stmt : this->statements) {
+      stmt->optimize_loops();
+    }
+  }
+  void Program_unit::optimize_loops()
+  {
+    current_program_unit = this;
+    loop_optimizer::fuse_adjacent_loops(this->statements);
+    for (auto &stmt : this->statements) {
+      stmt->optimize_loops();
+    }
+    for (auto &program : this->internal_programs) {
+      program->optimize_loops();
+    }
+    for (auto &program : this->external_programs) {
+      program->optimize_loops();
+    }
+  }
+}
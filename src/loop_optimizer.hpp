@@ -0,0 +1,7 @@
+#pragma once
+#include "ast.hpp"
+#include "option.hpp"
+
+namespace loop_optimizer {
+  void optimize(const std::shared_ptr<ast::Program_unit> program, const Compile_options &opts, std::string source_name);
+}
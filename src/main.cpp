@@ -7,12 +7,15 @@
 #include <cstdlib>
 #include "parser.hpp"
 #include "IR_generator.hpp"
+#include "constant_folder.hpp"
+#include "loop_optimizer.hpp"
 #include "ast.hpp"
+#include "option.hpp"
 
 /* program -> CST -> AST -> IR */
 /* CST -> ASTでエラーチェックを行い、AST -> IRは機械的に行う */
 
-bool compile(std::fstream &fs, std::string infile_name, std::string outfile_name, bool debug_mode) {
+bool compile(std::fstream &fs, std::string infile_name, std::string outfile_name, const Compile_options &opts, bool debug_mode) {
   std::string str, line;
   while (getline(fs, line)) {
     str += line + '\n';
@@ -23,12 +26,15 @@ bool compile(std::fstream &fs, std::string infile_name, std::string outfile_name
     std::cout << "=== CST ===" << std::endl;
     cst_program->print();
   }
-  std::shared_ptr<ast::Program_unit> ast_program = cst_program->ASTgen();
+  std::shared_ptr<ast::Program_unit> ast_program = cst_program->ASTgen(opts);
+  if (!ast_program) return false;
+  constant_folder::fold(ast_program);
+  loop_optimizer::optimize(ast_program, opts, infile_name);
   if (debug_mode) {
     std::cout << std::endl << "=== AST ===" << std::endl;
     ast_program->print("");
   }
-  IR_generator::generate_IR(ast_program, debug_mode);
+  IR_generator::generate_IR(ast_program, opts, infile_name, debug_mode);
   // generate .o
   IR_generator::codeout(outfile_name);
   return true;
@@ -49,6 +55,7 @@ void link(std::vector<std::string> file_list, std::vector<std::string> option_li
 
 int main(int argc, char* argv[]) {
   bool debug_mode = false;
+  Compile_options opts;
   std::vector<std::string> outfile_list;
   std::vector<std::string> objfile_list;
   std::vector<std::string> option_list;
@@ -56,7 +63,7 @@ int main(int argc, char* argv[]) {
   std::string output_name = "";
   bool success = true;
   int opt;
-  while ((opt = getopt(argc, argv, "co:dL:")) != -1) {
+  while ((opt = getopt(argc, argv, "co:dL:O:m:f:")) != -1) {
     switch (opt) {
     case 'c':
       link_flag = false;
@@ -70,6 +77,72 @@ int main(int argc, char* argv[]) {
     case 'L':
       option_list.push_back("-L" + std::string(optarg));
       break;
+    case 'O':
+      if (std::string(optarg).size() != 1 || optarg[0] < '0' || optarg[0] > '3') {
+        std::cout << "error: unknown optimization level -O" << optarg << std::endl;
+        return 1;
+      }
+      opts.opt_level = optarg[0] - '0';
+      break;
+    case 'm':
+      {
+        std::string arg = optarg;
+        if (arg.compare(0, 5, "arch=") == 0) {
+          opts.cpu = arg.substr(5);
+        } else if (arg.compare(0, 5, "attr=") == 0) {
+          opts.features = arg.substr(5);
+        } else {
+          std::cout << "error: unknown option -m" << arg << std::endl;
+          return 1;
+        }
+        break;
+      }
+    case 'f':
+      {
+        std::string arg = optarg;
+        if (arg.compare(0, 19, "stack-arrays-limit=") == 0) {
+          opts.stack_arrays_limit = std::stoull(arg.substr(19));
+        } else if (arg.compare(0, 16, "tile-cache-size=") == 0) {
+          opts.tile_cache_size = std::stoull(arg.substr(16));
+        } else if (arg == "prefetch-loop-arrays") {
+          opts.prefetch_loop_arrays = true;
+        } else if (arg.compare(0, 17, "prefetch-latency=") == 0) {
+          opts.prefetch_latency = std::stoull(arg.substr(17));
+        } else if (arg.compare(0, 9, "llc-size=") == 0) {
+          opts.llc_size = std::stoull(arg.substr(9));
+        } else if (arg.compare(0, 13, "inline-limit=") == 0) {
+          opts.inline_limit = std::stoull(arg.substr(13));
+        } else if (arg == "fast-math") {
+          opts.fast_math = true;
+          opts.no_signed_zeros = true;
+          opts.fp_contract = FP_contract::fast;
+        } else if (arg == "no-signed-zeros") {
+          opts.no_signed_zeros = true;
+        } else if (arg == "fp-contract=fast") {
+          opts.fp_contract = FP_contract::fast;
+        } else if (arg == "fp-contract=on") {
+          opts.fp_contract = FP_contract::on;
+        } else if (arg == "fp-contract=off") {
+          opts.fp_contract = FP_contract::off;
+        } else if (arg == "check=bounds") {
+          opts.check_bounds = true;
+        } else if (arg == "pad-arrays") {
+          opts.pad_arrays = true;
+        } else if (arg == "opt-info") {
+          opts.opt_info = true;
+        } else if (arg.compare(0, 16, "array-alignment=") == 0) {
+          unsigned alignment = std::stoul(arg.substr(16));
+          if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+            std::cout << "error: array alignment must be a power of two" << std::endl;
+            return 1;
+          }
+          opts.array_alignment = alignment;
+        } else {
+          std::cout << "error: unknown option -f" << arg << std::endl;
+          return 1;
+        }
+        break;
+      }
     }
   }
   option_list.push_back("-lfortio");
@@ -93,7 +166,7 @@ int main(int argc, char* argv[]) {
       if (link_flag) {
 	outfile_name = tmpdir + "/" + outfile_name;
       }
-      success &= compile(fs, filename, outfile_name, debug_mode);
+      success &= compile(fs, filename, outfile_name, opts, debug_mode);
       outfile_list.push_back(outfile_name);
       fs.close();
     } else if (filename.find(".o", filename.size() - 2) != std::string::npos) {
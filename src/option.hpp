@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+// -ffp-contract=, when a*b+c may be fused into one rounding
+enum class FP_contract {
+  off, // never
+  on, // within one expression
+  fast // anywhere, also across statements
+};
+
+/* options given by command line */
+class Compile_options {
+public:
+  int opt_level = 0;
+  std::string cpu = "generic"; // -march=, "native" means the host CPU
+  std::string features = "";  // -mattr=, e.g. "+avx2,-fma"
+  uint64_t stack_arrays_limit = 65536; // -fstack-arrays-limit=, in bytes
+  unsigned array_alignment = 64; // -farray-alignment=, in bytes, a power of two
+  bool opt_info = false; // -fopt-info, report the applied loop transformations
+  uint64_t tile_cache_size = 32768; // -ftile-cache-size=, in bytes, the data cache loop tiles are sized for
+  bool prefetch_loop_arrays = false; // -fprefetch-loop-arrays
+  uint64_t prefetch_latency = 200; // -fprefetch-latency=, in cycles, how far ahead the prefetches are issued
+  bool fast_math = false; // -ffast-math
+  bool no_signed_zeros = false; // -fno-signed-zeros, also set by -ffast-math
+  FP_contract fp_contract = FP_contract::off; // -ffp-contract=, -ffast-math makes it fast
+  bool check_bounds = false; // -fcheck=bounds, check every subscript at run time
+  bool pad_arrays = false; // -fpad-arrays, pad the leading extent of arrays to avoid cache set conflicts
+  uint64_t llc_size = 8388608; // -fllc-size=, in bytes, arrays larger than it are prefetched
+  uint64_t inline_limit = 200; // -finline-limit=, in IR instructions, procedures called in loops up to it are inlined
+};
@@ -19,8 +19,11 @@ namespace parser{
   // prototype declarations for recursive constructs
   std::unique_ptr<Executable_construct> parse_action_stmt();
   std::unique_ptr<Expression> parse_expression();
+  std::unique_ptr<Expression> parse_array_constructor();
+  std::unique_ptr<Expression> parse_implied_do(std::unique_ptr<Expression> (*parse_value)());
+  std::unique_ptr<Variable> parse_designator();
   std::unique_ptr<Executable_construct> parse_executable_constructs();
-  // TODO: multiple Program Unit
+  std::unique_ptr<Program> parse_subprogram(bool is_internal);
   // TODO: fixed form
   // TODO: continuous line
   int row;
@@ -217,11 +220,36 @@ namespace parser{
     return false;
   }
 
-  std::unique_ptr<Specification> parse_type_declaration()
+  // kind-selector is ( [ KIND = ] scalar-int-constant-expr )
+  // only literal constant is accepted for now
+  int parse_kind_selector()
+  {
+    save_ofs();
+    std::string value;
+    if (!read_token("(")) goto failexit;
+    if (read_token("kind")) {
+      if (!read_token("=")) goto failexit;
+    }
+    current_line->skip_blanks();
+    value = current_line->read_int_constant();
+    if (value == "" || !read_token(")")) goto failexit;
+    discard_saved_ofs();
+    return std::stoi(value);
+  failexit:
+    restore_ofs();
+    return 0;
+  }
+
+  // declaration-type-spec of a type-declaration-stmt or of a function-stmt
+  std::unique_ptr<Type_specification> parse_declaration_type_spec()
   {
     std::unique_ptr<Type_specification> spec;
     if (read_token("integer")) {
-      spec = std::make_unique<Type_specification>(Type_kind::Intrinsic, "integer");
+      int kind_param = parse_kind_selector();
+      if (kind_param != 0 && kind_param != 4 && kind_param != 8) {
+        error("unsupported kind of integer", err_kind::character);
+      }
+      spec = std::make_unique<Type_specification>(Type_kind::Intrinsic, "integer", nullptr, kind_param == 8 ? 8 : 0);
     } else if (read_token("real")) {
       spec = std::make_unique<Type_specification>(Type_kind::Intrinsic, "real");
     } else if (read_token("logical")) {
@@ -233,18 +261,77 @@ namespace parser{
         read_token(")");
       }
       spec = std::make_unique<Type_specification>(Type_kind::Intrinsic, "character", std::move(exp));
-    } else {
-      return nullptr;
     }
-    read_one_blank(); // TOOD: semicolon should be also accepted
+    return spec;
+  }
+
+  std::unique_ptr<Specification> parse_type_declaration()
+  {
+    std::unique_ptr<Type_specification> spec = parse_declaration_type_spec();
+    if (!spec) return nullptr;
+    // only the PARAMETER attribute is supported
+    while (read_token(",")) {
+      if (read_token("parameter")) {
+        spec->set_parameter_attr();
+      } else {
+        error("unsupported attribute", err_kind::name);
+        skip_this_line();
+        skip_blank_lines();
+        return spec;
+      }
+    }
+    if (!read_token("::")) {
+      read_one_blank(); // TOOD: semicolon should be also accepted
+    }
     do {
       std::string name = read_name();
       spec->add_variable(name);
+      if (spec->has_parameter_attr()) {
+        if (!read_token("=")) {
+          error("missing initialization of named constant", err_kind::character);
+          skip_this_line();
+          skip_blank_lines();
+          return spec;
+        }
+        spec->add_named_constant(std::make_unique<Named_constant_definition>(name, parse_expression()));
+      }
     } while (read_token(","));
     assert_end_of_line();
     return spec;
   }
 
+  // parameter-stmt is PARAMETER ( named-constant = constant-expr [, ...] )
+  std::unique_ptr<Specification> parse_parameter_stmt()
+  {
+    save_ofs();
+    std::unique_ptr<Parameter_statement> parameter_stmt { new Parameter_statement() };
+    if (!read_token("parameter") || !read_token("(")) goto failexit;
+    discard_saved_ofs();
+    do {
+      std::string name = read_name();
+      std::unique_ptr<Expression> expr;
+      if (name == "" || !read_token("=") || !(expr = parse_expression())) {
+        error("invalid named constant definition", err_kind::character);
+        skip_this_line();
+        skip_blank_lines();
+        return parameter_stmt;
+      }
+      parameter_stmt->add_named_constant(std::make_unique<Named_constant_definition>(name, std::move(expr)));
+    } while (read_token(","));
+    if (!read_token(")")) {
+      error("missing ')' in parameter-stmt", err_kind::character);
+      skip_this_line();
+      skip_blank_lines();
+      return parameter_stmt;
+    }
+    assert_end_of_line();
+    return parameter_stmt;
+
+  failexit:
+    restore_ofs();
+    return nullptr;
+  }
+
   std::unique_ptr<Explicit_shape_spec> parse_explicit_shape_spec()
   {
     save_ofs();
@@ -305,10 +392,89 @@ namespace parser{
     return nullptr;
   }
 
+  // data-stmt-object is variable or data-implied-do
+  std::unique_ptr<Expression> parse_data_stmt_object()
+  {
+    std::unique_ptr<Expression> object;
+    if ((object = parse_implied_do(parse_data_stmt_object))) return object;
+    return parse_designator();
+  }
+
+  // data-stmt-constant is [sign] literal-constant or named-constant
+  std::unique_ptr<Expression> parse_data_stmt_constant()
+  {
+    bool negative = read_token("-");
+    if (!negative) read_token("+");
+    current_line->skip_blanks();
+    std::unique_ptr<Constant> value = read_constant();
+    if (value) {
+      if (negative) value->negate();
+      return std::move(value);
+    }
+    std::string name = read_name();
+    if (name == "") return nullptr;
+    if (!negative) return std::make_unique<Variable>(name);
+    std::unique_ptr<Operator> negation { new Operator() };
+    negation->add_operand(std::make_unique<Constant>(Type_kind::Intrinsic, "integer", "0"));
+    negation->add_operator("-");
+    negation->add_operand(std::make_unique<Variable>(name));
+    return std::move(negation);
+  }
+
+  // data-stmt is DATA object-list / [repeat*] value-list / [[,] object-list / value-list /] ...
+  std::unique_ptr<Specification> parse_data_stmt()
+  {
+    save_ofs();
+    std::unique_ptr<Data_statement> data_stmt { new Data_statement() };
+    if (!read_token("data") || !read_one_blank(false)) goto failexit;
+    discard_saved_ofs();
+    do {
+      auto set = std::make_unique<Data_statement_set>();
+      do {
+        std::unique_ptr<Expression> object = parse_data_stmt_object();
+        if (!object) goto errexit;
+        set->add_object(std::move(object));
+      } while (read_token(","));
+      if (!read_token("/")) goto errexit;
+      do {
+        int64_t repeat = 1;
+        save_ofs();
+        current_line->skip_blanks();
+        std::string count = current_line->read_int_constant();
+        if (count != "" && read_token("*")) {
+          repeat = std::stoll(count);
+          discard_saved_ofs();
+        } else {
+          restore_ofs();
+        }
+        std::unique_ptr<Expression> value = parse_data_stmt_constant();
+        if (!value) goto errexit;
+        set->add_value(repeat, std::move(value));
+      } while (read_token(","));
+      if (!read_token("/")) goto errexit;
+      data_stmt->add_set(std::move(set));
+      read_token(",");
+    } while (!is_end_of_line());
+    assert_end_of_line();
+    return data_stmt;
+
+  failexit:
+    restore_ofs();
+    return nullptr;
+
+  errexit:
+    error("invalid data-stmt", err_kind::character);
+    skip_this_line();
+    skip_blank_lines();
+    return data_stmt;
+  }
+
   std::unique_ptr<Specification> parse_other_specification_stmt()
   {
     std::unique_ptr<Specification> spec;
     if ((spec = parse_dimension_stmt())) return std::move(spec);
+    if ((spec = parse_parameter_stmt())) return std::move(spec);
+    if ((spec = parse_data_stmt())) return std::move(spec);
     return nullptr;
   }
   
@@ -320,10 +486,27 @@ namespace parser{
     return nullptr;
   }
 
+  // subscript or subscript-triplet, [subscript] : [subscript] [: stride]
   std::unique_ptr<Expression> parse_section_subscript()
   {
-    // only subscript for now
-    return parse_expression();
+    std::unique_ptr<Expression> lower, upper, stride;
+    if (!read_token(":")) {
+      lower = parse_expression();
+      if (!lower || !read_token(":")) return lower;
+    }
+    // the upper bound is omitted when the triplet ends or the stride follows
+    save_ofs();
+    bool has_upper = !read_token(",") && !read_token(")") && !read_token(":");
+    restore_ofs();
+    if (has_upper) {
+      upper = parse_expression();
+      if (!upper) return nullptr;
+    }
+    if (read_token(":")) {
+      stride = parse_expression();
+      if (!stride) return nullptr;
+    }
+    return std::make_unique<Subscript_triplet>(std::move(lower), std::move(upper), std::move(stride));
   }
 
   std::unique_ptr<Array_element> parse_data_ref()
@@ -336,16 +519,21 @@ namespace parser{
 
     if (name == "") goto failexit;
     if (!read_token("(")) goto failexit;
-    while (true) {
+    // f() references a function without arguments
+    while (!read_token(")")) {
       subscript = parse_section_subscript();
       if (!subscript) goto failexit;
       subscripts.push_back(std::move(subscript));
-      if (!read_token(",")) break;
+      if (read_token(")")) break;
+      if (!read_token(",")) goto failexit;
     }
-    if (!read_token(")")) goto failexit;
 
     discard_saved_ofs();
-    return std::make_unique<Array_element>(name, std::move(subscripts));
+    {
+      auto element = std::make_unique<Array_element>(name, std::move(subscripts));
+      element->set_line_num(row+1);
+      return element;
+    }
  
   failexit:
     restore_ofs();
@@ -380,6 +568,8 @@ namespace parser{
       return static_cast<std::unique_ptr<Expression>>(std::move(value));
     } // TODO: static_castなしでexpに代入してreturnできないか
     
+    if ((exp = parse_array_constructor())) return std::move(exp);
+
     if (read_token("(")) {
       std::unique_ptr<Expression> exp = parse_expression();
       read_token(")");
@@ -388,6 +578,74 @@ namespace parser{
     return nullptr;
   }
 
+  // implied-do is ( value-list, do-variable = start, end [, stride] )
+  // the values are parsed by parse_value, they may be implied-DOs again
+  std::unique_ptr<Expression> parse_implied_do(std::unique_ptr<Expression> (*parse_value)())
+  {
+    save_ofs();
+    std::vector<std::unique_ptr<Expression>> values;
+    std::string do_variable;
+    std::unique_ptr<Expression> start, end, stride;
+    if (!read_token("(")) goto failexit;
+    while (true) {
+      // the values end where "name =" begins
+      save_ofs();
+      do_variable = read_name();
+      if (do_variable != "" && !read_token("==") && read_token("=")) {
+        discard_saved_ofs();
+        break;
+      }
+      restore_ofs();
+      std::unique_ptr<Expression> value = parse_value();
+      if (!value || !read_token(",")) goto failexit;
+      values.push_back(std::move(value));
+    }
+    if (values.size() == 0) goto failexit;
+    if (!(start = parse_expression()) || !read_token(",") || !(end = parse_expression())) goto failexit;
+    if (read_token(",") && !(stride = parse_expression())) goto failexit;
+    if (!read_token(")")) goto failexit;
+    discard_saved_ofs();
+    return std::make_unique<Implied_do>(std::move(values), do_variable,
+                                        std::move(start), std::move(end), std::move(stride));
+  failexit:
+    restore_ofs();
+    return nullptr;
+  }
+
+  // ac-value is expr or ac-implied-do
+  std::unique_ptr<Expression> parse_ac_value()
+  {
+    std::unique_ptr<Expression> value;
+    if ((value = parse_implied_do(parse_ac_value))) return value;
+    return parse_expression();
+  }
+
+  // array-constructor is (/ ac-value-list /) or [ ac-value-list ]
+  std::unique_ptr<Expression> parse_array_constructor()
+  {
+    std::string close;
+    if (read_token("(/")) {
+      close = "/)";
+    } else if (read_token("[")) {
+      close = "]";
+    } else {
+      return nullptr;
+    }
+    auto constructor = std::make_unique<Array_constructor>();
+    do {
+      std::unique_ptr<Expression> value = parse_ac_value();
+      if (!value) {
+        error("invalid value in array constructor", err_kind::character);
+        return constructor;
+      }
+      constructor->add_value(std::move(value));
+    } while (read_token(","));
+    if (!read_token(close)) {
+      error("missing '" + close + "' in array constructor", err_kind::character);
+    }
+    return constructor;
+  }
+
   // add-operand is [ add-operand mult-op ] mult-operand
   std::unique_ptr<Expression> parse_add_operand()
   {
@@ -415,7 +673,16 @@ namespace parser{
   std::unique_ptr<Expression> parse_level2_expr()
   {
     std::unique_ptr<Operator> exp { new Operator() };
+    bool negative = read_token("-");
     std::unique_ptr<Expression> operand = parse_add_operand();
+    if (negative && operand) {
+      // -x is 0-x
+      std::unique_ptr<Operator> negation { new Operator() };
+      negation->add_operand(std::make_unique<Constant>(Type_kind::Intrinsic, "integer", "0"));
+      negation->add_operator("-");
+      negation->add_operand(std::move(operand));
+      operand = std::move(negation);
+    }
     while (true) {
       if (read_operator("+")) {
         exp->add_operator("+");
@@ -516,6 +783,56 @@ namespace parser{
     std::unique_ptr<Executable_construct> action_stmt = parse_action_stmt();
     return std::make_unique<If_statement>(std::move(expr), std::move(action_stmt));
   }
+  // call-stmt is CALL procedure-name [ ( [ actual-arg-list ] ) ]
+  std::unique_ptr<Executable_construct> parse_call_stmt()
+  {
+    save_ofs();
+    int line_num = row+1;
+    std::vector<std::unique_ptr<Expression>> args;
+    std::string name;
+    if (!read_token("call") || !read_one_blank(false)) {
+      restore_ofs();
+      return nullptr;
+    }
+    discard_saved_ofs();
+    name = read_name();
+    if (name == "") {
+      error("missing procedure name in call-stmt", err_kind::character);
+      goto errexit;
+    }
+    if (read_token("(") && !read_token(")")) {
+      do {
+        std::unique_ptr<Expression> arg = parse_expression();
+        if (!arg) {
+          error("invalid actual argument in call-stmt", err_kind::character);
+          goto errexit;
+        }
+        args.push_back(std::move(arg));
+      } while (read_token(","));
+      if (!read_token(")")) {
+        error("missing ')' in call-stmt", err_kind::character);
+        goto errexit;
+      }
+    }
+    assert_end_of_line();
+    return std::make_unique<Call_statement>(name, std::move(args), line_num);
+
+  errexit:
+    skip_this_line();
+    skip_blank_lines();
+    return std::make_unique<Call_statement>(name, std::move(args), line_num);
+  }
+  std::unique_ptr<Executable_construct> parse_return_stmt()
+  {
+    save_ofs();
+    if (!read_token("return") || !is_end_of_line()) {
+      restore_ofs();
+      return nullptr;
+    }
+    discard_saved_ofs();
+    assert_end_of_line();
+    return std::make_unique<Return_statement>();
+  }
   std::unique_ptr<Executable_construct> parse_action_stmt()
   {
     std::unique_ptr<Executable_construct> exec;
@@ -523,12 +840,64 @@ namespace parser{
     if ((exec = parse_print_stmt())) return std::move(exec);
     // TODO: if文かif構文かこれだけではわからないはず
     if ((exec = parse_if_stmt())) return std::move(exec);
+    if ((exec = parse_call_stmt())) return std::move(exec);
+    if ((exec = parse_return_stmt())) return std::move(exec);
     return nullptr;
   }
+  // n of "(n)" or of " n", -1 when missing
+  int64_t read_directive_argument(Line &line)
+  {
+    bool paren = line.read_token("(");
+    line.skip_blanks();
+    std::string value = line.read_int_constant();
+    if (value == "" || (paren && !line.read_token(")"))) return -1;
+    return std::stoll(value);
+  }
+  // block(n), unroll[(n)], nounroll, ivdep, vector [always], novector
+  bool parse_loop_directive(Line &line, ast::Loop_directives &directives)
+  {
+    if (line.read_token("block")) {
+      directives.block_size = read_directive_argument(line);
+      if (directives.block_size < 0) return false;
+    } else if (line.read_token("unroll")) {
+      int64_t count = 0;
+      if (!line.is_end_of_line()) {
+        count = read_directive_argument(line);
+        if (count < 0) return false;
+      }
+      directives.unroll = count;
+    } else if (line.read_token("nounroll")) {
+      directives.unroll = 1;
+    } else if (line.read_token("ivdep")) {
+      directives.ivdep = true;
+    } else if (line.read_token("vector")) {
+      line.read_token("always");
+      directives.vector_always = true;
+    } else if (line.read_token("novector")) {
+      directives.novector = true;
+    } else {
+      return false;
+    }
+    return line.is_end_of_line();
+  }
+  // directives on the comment lines above the statement at source[stmt_row]
+  ast::Loop_directives parse_loop_directives(int stmt_row)
+  {
+    ast::Loop_directives directives;
+    for (int i = stmt_row-1; i >= 0 && source[i]->is_comment_line(); i--) {
+      std::string text = source[i]->get_directive();
+      if (text == "") continue;
+      Line line(source[i]->get_line_num(), text);
+      if (parse_loop_directive(line, directives)) continue;
+      std::cout << filename << ":" << source[i]->get_line_num() << " warning: ignoring unknown directive" << std::endl;
+    }
+    return directives;
+  }
   std::unique_ptr<Do_construct> parse_do_stmt()
   {
     // nonlabel-do-stmt is [ do-construct-name : ] DO [ loop-control ]
     save_ofs();
+    int line_num = row+1;
     std::string token_or_name = read_name();
     std::string do_construct_name = "";
     std::string do_variable_name;
@@ -569,11 +938,16 @@ namespace parser{
     }
     discard_saved_ofs();
     assert_end_of_line();
-    return std::make_unique<Do_with_do_variable>(do_construct_name,
-                                                 std::make_unique<Variable>(do_variable_name),
-                                                 std::move(start_expr),
-                                                 std::move(end_expr),
-                                                 std::move(stride_expr));
+    {
+      auto do_construct = std::make_unique<Do_with_do_variable>(do_construct_name,
+                                                                std::make_unique<Variable>(do_variable_name),
+                                                                std::move(start_expr),
+                                                                std::move(end_expr),
+                                                                std::move(stride_expr));
+      do_construct->set_line_num(line_num);
+      do_construct->set_directives(parse_loop_directives(line_num-1));
+      return std::move(do_construct);
+    }
   parse_fail:
     restore_ofs();
     return nullptr;
@@ -618,31 +992,247 @@ namespace parser{
     parse_end_do_stmt(do_construct->get_construct_name());
     return std::move(do_construct);
   }
+  // where-stmt is WHERE ( mask-expr ) where-assignment-stmt
+  // where-construct is WHERE ( mask-expr ) ... [ELSEWHERE [( mask-expr )] ...] END WHERE
+  std::unique_ptr<Executable_construct> parse_where_construct()
+  {
+    save_ofs();
+    if (!read_token("where") || !read_token("(")) {
+      restore_ofs();
+      return nullptr;
+    }
+    discard_saved_ofs();
+    auto where_construct = std::make_unique<Where_construct>();
+    where_construct->add_clause(parse_expression());
+    if (!read_token(")")) {
+      error("\")\" is expected in WHERE statement", err_kind::character);
+    }
+    if (!is_end_of_line()) {
+      std::unique_ptr<Assignment_statement> stmt = parse_assignment_stmt();
+      if (!stmt) {
+        error("assignment statement is expected in WHERE statement", err_kind::end_of_line);
+        skip_this_line();
+        skip_blank_lines();
+        return where_construct;
+      }
+      where_construct->add_assignment(std::move(stmt));
+      return where_construct;
+    }
+    assert_end_of_line();
+    while (true) {
+      std::unique_ptr<Assignment_statement> stmt;
+      while ((stmt = parse_assignment_stmt())) {
+        where_construct->add_assignment(std::move(stmt));
+      }
+      if (!read_token("elsewhere") && !(read_token("else") && read_token("where"))) break;
+      if (!where_construct->has_mask()) {
+        error("ELSEWHERE after the ELSEWHERE without a mask", err_kind::end_of_line);
+      }
+      std::unique_ptr<Expression> mask;
+      if (read_token("(")) {
+        mask = parse_expression();
+        if (!read_token(")")) {
+          error("\")\" is expected in ELSEWHERE statement", err_kind::character);
+        }
+      }
+      where_construct->add_clause(std::move(mask));
+      assert_end_of_line();
+    }
+    if (!read_token("end") || !read_token("where")) {
+      error("END WHERE statement is expected", err_kind::end_of_line);
+      skip_this_line();
+      return where_construct;
+    }
+    assert_end_of_line();
+    return where_construct;
+  }
   std::unique_ptr<Executable_construct> parse_executable_constructs()
   {
     std::unique_ptr<Executable_construct> exec;
     if ((exec = parse_action_stmt())) return std::move(exec);
     if ((exec = parse_do_construct())) return std::move(exec);
+    if ((exec = parse_where_construct())) return std::move(exec);
     return nullptr;
   }
-  std::unique_ptr<Program> parse_main_program()
+  // the specification part and the execution part of a program unit
+  void parse_program_body(Program &program)
   {
-    std::unique_ptr<Program> program = parse_program_stmt();
     std::unique_ptr<Specification> spec;
     while ((spec = parse_declaration_construct())) {
-      program->add_specification(std::move(spec));
+      program.add_specification(std::move(spec));
     }
     std::unique_ptr<Executable_construct> exec;
     while ((exec = parse_executable_constructs())) {
-      program->add_executable_construct(std::move(exec));
+      program.add_executable_construct(std::move(exec));
     }
+  }
+  // internal-subprogram-part is CONTAINS [ internal-subprogram ] ...
+  void parse_internal_subprogram_part(Program &host, bool is_internal)
+  {
+    save_ofs();
+    if (!read_token("contains") || !is_end_of_line()) {
+      restore_ofs();
+      return;
+    }
+    discard_saved_ofs();
+    if (is_internal) {
+      error("internal subprogram cannot contain subprograms", err_kind::character);
+    }
+    assert_end_of_line();
+    std::unique_ptr<Program> subprogram;
+    while ((subprogram = parse_subprogram(true))) {
+      host.add_internal_subprogram(std::move(subprogram));
+    }
+  }
+  // function-stmt is [ declaration-type-spec ] FUNCTION name ( [ dummy-arg-list ] ) [ RESULT ( result-name ) ]
+  // subroutine-stmt is SUBROUTINE name [ ( [ dummy-arg-list ] ) ]
+  std::unique_ptr<Program> parse_subprogram_stmt()
+  {
+    save_ofs();
+    std::unique_ptr<Type_specification> type_spec = parse_declaration_type_spec();
+    std::unique_ptr<Program> subprogram;
+    std::string keyword;
+    std::string name;
+    std::string result_name;
+    if (read_token("function")) {
+      keyword = "function";
+    } else if (!type_spec && read_token("subroutine")) {
+      keyword = "subroutine";
+    } else {
+      restore_ofs();
+      return nullptr;
+    }
+    discard_saved_ofs();
+    if (!read_one_blank()) goto errexit;
+    name = read_name();
+    if (name == "") {
+      error("missing " + keyword + " name in " + keyword + "-stmt", err_kind::character);
+      goto errexit;
+    }
+    subprogram = std::make_unique<Program>(name, keyword == "function" ? Program_kind::function : Program_kind::subroutine);
+    if (read_token("(")) {
+      if (!read_token(")")) {
+        do {
+          std::string arg = read_name();
+          if (arg == "") {
+            error("invalid dummy argument in " + keyword + "-stmt", err_kind::character);
+            goto errexit;
+          }
+          subprogram->add_dummy_argument(arg);
+        } while (read_token(","));
+        if (!read_token(")")) {
+          error("missing ')' in " + keyword + "-stmt", err_kind::character);
+          goto errexit;
+        }
+      }
+    } else if (keyword == "function") {
+      error("missing '(' in function-stmt", err_kind::character);
+      goto errexit;
+    }
+    if (keyword == "function") {
+      result_name = name;
+      if (read_token("result")) {
+        if (!read_token("(") || (result_name = read_name()) == "" || !read_token(")")) {
+          error("invalid result name in function-stmt", err_kind::character);
+          goto errexit;
+        }
+      }
+      subprogram->set_result_name(result_name);
+      // the type in the prefix declares the result variable
+      if (type_spec) {
+        type_spec->add_variable(result_name);
+        subprogram->add_specification(std::move(type_spec));
+      }
+    }
+    assert_end_of_line();
+    return subprogram;
+
+  errexit:
+    skip_this_line();
+    skip_blank_lines();
+    if (!subprogram) subprogram = std::make_unique<Program>(name, Program_kind::subroutine);
+    return subprogram;
+  }
+  // end-subroutine-stmt is END [ SUBROUTINE [ name ] ], and end-function-stmt is END [ FUNCTION [ name ] ]
+  bool parse_end_subprogram_stmt(const Program &subprogram)
+  {
+    std::string keyword = subprogram.get_kind() == Program_kind::function ? "function" : "subroutine";
+    if (!read_token("end")) {
+      error("END " + keyword + " statement is expected", err_kind::end_of_line);
+      goto errexit;
+    }
+    if (is_end_of_line()) {
+      skip_blank_lines();
+      return true;
+    }
+    if (!read_one_blank()) {
+      goto errexit;
+    }
+    if (!read_token(keyword)) {
+      error("unexpected token in end-" + keyword + "-stmt", err_kind::character);
+      goto errexit;
+    }
+    if (is_end_of_line()) {
+      skip_blank_lines();
+      return true;
+    }
+    if (!read_one_blank()) {
+      goto errexit;
+    }
+    if (!read_token(subprogram.get_name())) {
+      error("name is different from the corresponding " + keyword + "-stmt", err_kind::name);
+      goto errexit;
+    }
+    return assert_end_of_line();
+
+  errexit:
+    skip_this_line();
+    skip_blank_lines();
+    return false;
+  }
+  std::unique_ptr<Program> parse_subprogram(bool is_internal)
+  {
+    std::unique_ptr<Program> subprogram = parse_subprogram_stmt();
+    if (!subprogram) return nullptr;
+    parse_program_body(*subprogram);
+    parse_internal_subprogram_part(*subprogram, is_internal);
+    parse_end_subprogram_stmt(*subprogram);
+    return subprogram;
+  }
+  std::unique_ptr<Program> parse_main_program()
+  {
+    std::unique_ptr<Program> program = parse_program_stmt();
+    parse_program_body(*program);
+    parse_internal_subprogram_part(*program, false);
     parse_end_program_stmt(program->get_name());
     return std::move(program);
   }
+  // a main program and external subprograms in any order, the subprograms are kept by the main program
   std::unique_ptr<Program> parse(const std::string str, const std::string name)
   {
     preprocess(str, name);
-    std::unique_ptr<Program> program = parse_main_program();
+    std::unique_ptr<Program> program;
+    std::vector<std::unique_ptr<Program>> subprograms;
+    skip_blank_lines();
+    while (!is_eof()) {
+      std::unique_ptr<Program> subprogram = parse_subprogram(false);
+      if (subprogram) {
+        subprograms.push_back(std::move(subprogram));
+      } else if (!program) {
+        program = parse_main_program();
+      } else {
+        error("unexpected statement after the end of the program unit", err_kind::end_of_line);
+        break;
+      }
+      skip_blank_lines();
+    }
+    if (!program) {
+      // no main program, only the subprograms are compiled
+      program = std::make_unique<Program>("");
+    }
+    for (auto &subprogram : subprograms) {
+      program->add_external_subprogram(std::move(subprogram));
+    }
     if (error_occured) {
       return nullptr;
     } else {
@@ -1,10 +1,30 @@
 #include "parser.hpp"
 #include "ast.hpp"
+#include "constant_folder.hpp"
 #include <set>
 
-static std::unique_ptr<std::map<std::string, std::shared_ptr<ast::Variable>>> current_variable_table;
-static std::unique_ptr<std::map<std::string, std::shared_ptr<ast::Type>>> current_type_table;
+static std::map<std::string, std::shared_ptr<ast::Variable>> *current_variable_table;
+static std::map<std::string, std::shared_ptr<ast::Type>> *current_type_table;
 static std::shared_ptr<ast::Program_unit> current_program_unit;
+// a program unit being analyzed. The names it doesn't declare are looked up in its host
+struct Scope {
+  const cst::Program *program;
+  std::shared_ptr<ast::Program_unit> unit;
+  // values of the named constants, they have no storage and are replaced at every reference
+  std::map<std::string, std::unique_ptr<ast::Expression>> named_constants;
+  // the internal subprograms by name
+  std::map<std::string, std::shared_ptr<ast::Program_unit>> procedures;
+  Scope *host;
+};
+// hosts come before their internal subprograms
+static std::vector<std::unique_ptr<Scope>> scopes;
+static Scope *current_scope;
+// the external subprograms of the file, and the ones of other files called here
+static std::map<std::string, std::shared_ptr<ast::Program_unit>> external_procedures;
+// variables of the host are referenced only in the execution part, a declaration makes a local one
+static bool host_association_enabled;
+static bool semantic_error_occured;
+static Compile_options options;
 
 namespace cst {
   template<typename TO, typename FROM>
@@ -18,15 +38,123 @@ namespace cst {
     //conversion: shared_ptr<FROM>->FROM*->TO*->shared_ptr<TO>
   }
 
-  std::shared_ptr<ast::Variable> get_or_create_var(std::string name) {
+  void semantic_error(std::string msg) {
+    std::cout << "error: " << msg << std::endl;
+    semantic_error_occured = true;
+  }
+
+  // nullptr when the name is not a named constant of the program unit or its host
+  const ast::Expression *find_named_constant(std::string name) {
+    for (Scope *scope = current_scope; scope; scope = scope->host) {
+      auto named_constant = scope->named_constants.find(name);
+      if (named_constant != scope->named_constants.end()) return named_constant->second.get();
+      // a local variable hides the names of the host
+      auto var = scope->unit->get_variables().find(name);
+      if (var != scope->unit->get_variables().end() && var->second) return nullptr;
+    }
+    return nullptr;
+  }
+
+  // is_definition is true when the variable may be defined where it is referenced
+  std::shared_ptr<ast::Variable> get_or_create_var(std::string name, bool is_definition = false) {
     std::shared_ptr<ast::Variable> var = (*current_variable_table)[name];
-    if (!var) {
-      var = std::make_shared<ast::Variable>(name);
-      (*current_variable_table)[name] = var;
+    if (var) {
+      if (is_definition && var->is_dummy() && current_program_unit->get_kind() == ast::Program_unit_kind::function) {
+        semantic_error("function '" + current_program_unit->get_name() + "' defines its dummy argument '" + name + "'");
+      }
+      return var;
     }
+    for (Scope *scope = current_scope->host; host_association_enabled && scope; scope = scope->host) {
+      auto host_var = scope->unit->get_variables().find(name);
+      if (host_var == scope->unit->get_variables().end() || !host_var->second) continue;
+      var = host_var->second;
+      if (var->is_dummy()) {
+        semantic_error("dummy argument '" + name + "' of the host is referenced by '" +
+                       current_program_unit->get_name() + "', it is not supported");
+      }
+      var->set_host_associated();
+      current_program_unit->add_host_variable(var);
+      if (is_definition) current_program_unit->add_host_definition(name);
+      current_variable_table->erase(name);
+      return var;
+    }
+    var = std::make_shared<ast::Variable>(name);
+    (*current_variable_table)[name] = var;
     return var;
   }
+
+  // nullptr when the name is not a subprogram, a local variable hides the ones of the host
+  std::shared_ptr<ast::Program_unit> find_procedure(std::string name) {
+    for (Scope *scope = current_scope; scope; scope = scope->host) {
+      auto var = scope->unit->get_variables().find(name);
+      if ((var != scope->unit->get_variables().end() && var->second) || scope->named_constants.count(name)) {
+        return nullptr;
+      }
+      auto procedure = scope->procedures.find(name);
+      if (procedure != scope->procedures.end()) return procedure->second;
+    }
+    auto procedure = external_procedures.find(name);
+    if (procedure != external_procedures.end()) return procedure->second;
+    return nullptr;
+  }
   
+  // integer < integer(8) < real
+  int get_type_rank(ast::Type_kind kind)
+  {
+    switch (kind) {
+    case ast::Type_kind::i32:
+      return 0;
+    case ast::Type_kind::i64:
+      return 1;
+    case ast::Type_kind::fp32:
+      return 2;
+    default:
+      // error message should be output
+      assert(0);
+    }
+  }
+  std::unique_ptr<ast::Expression> convert_type(std::unique_ptr<ast::Expression> expr, ast::Type_kind kind)
+  {
+    ast::Type_kind from = expr->get_type_kind();
+    if (from == kind) return expr;
+    if (auto *constructor = dynamic_cast<ast::Array_constructor*>(expr.get())) {
+      // the elements are converted, so a constant constructor stays constant
+      for (auto &element : constructor->get_elements()) {
+        element = convert_type(std::move(element), kind);
+        constant_folder::fold_expression(element);
+      }
+      return expr;
+    }
+    ast::unary_op_kind op;
+    if (from == ast::Type_kind::i32 && kind == ast::Type_kind::fp32) {
+      op = ast::unary_op_kind::i32tofp32;
+    } else if (from == ast::Type_kind::i32 && kind == ast::Type_kind::i64) {
+      op = ast::unary_op_kind::i32toi64;
+    } else if (from == ast::Type_kind::i64 && kind == ast::Type_kind::i32) {
+      op = ast::unary_op_kind::i64toi32;
+    } else if (from == ast::Type_kind::i64 && kind == ast::Type_kind::fp32) {
+      op = ast::unary_op_kind::i64tofp32;
+    } else {
+      // error message should be output
+      assert(0);
+    }
+    return std::make_unique<ast::Unary_op>(op, std::move(expr));
+  }
+
+  // the extents of sections known only at run time are not checked
+  bool is_conformable(const ast::Shape &a, const ast::Shape &b)
+  {
+    if (a.get_rank() != b.get_rank()) return false;
+    auto is_constant = [](const ast::Shape &shape, int i) {
+      return shape.get_lower_bound(i).is_constant_int() && shape.get_upper_bound(i).is_constant_int();
+    };
+    for (int i=0; i<a.get_rank(); i++) {
+      if (!is_constant(a, i) || !is_constant(b, i)) continue;
+      if (std::max<int64_t>(a.get_size(i), 0) != std::max<int64_t>(b.get_size(i), 0)) return false;
+    }
+    return true;
+  }
+
   bool is_binary_operator(std::string op)
   {
     static std::set<std::string> binary_ops{"+", "-", "*", "/", "==", "/=", "<", "<=", ">", ">="};
@@ -36,51 +164,261 @@ namespace cst {
   {
     return false;
   }
-  std::unique_ptr<ast::Variable_definition> Variable::ASTgen_definition() const
+  std::unique_ptr<ast::Variable_definition> Variable::ASTgen_definition(bool is_defined) const
+  {
+    if (const ast::Expression *named_constant = find_named_constant(this->name)) {
+      semantic_error("named constant '" + this->name + "' cannot be defined");
+      // a dummy variable to continue the analysis
+      auto var = std::make_shared<ast::Variable>(this->name);
+      var->set_type(std::make_shared<ast::Type>(named_constant->get_type_kind()));
+      return std::make_unique<ast::Variable_definition>(var);
+    }
+    if (find_procedure(this->name)) {
+      semantic_error("procedure '" + this->name + "' cannot be defined");
+    }
+    return std::make_unique<ast::Variable_definition>(get_or_create_var(this->name, is_defined));
+  }
+  bool Array_element::is_section() const
+  {
+    for (auto &subscript : this->subscripts) {
+      if (dynamic_cast<Subscript_triplet*>(subscript.get())) return true;
+    }
+    return false;
+  }
+  // a subscript of a section, converted to index_type_kind
+  std::unique_ptr<ast::Expression> ASTgen_section_index(const Expression &subscript, std::string name)
   {
-    return std::make_unique<ast::Variable_definition>(get_or_create_var(this->name));
+    std::unique_ptr<ast::Expression> index = subscript.ASTgen();
+    if (!ast::is_integer_kind(index->get_type_kind())) {
+      semantic_error("subscript of array section '" + name + "' is not an integer");
+      return std::make_unique<ast::Int64_constant>(1);
+    }
+    return convert_type(std::move(index), ast::index_type_kind);
   }
-  std::unique_ptr<ast::Variable_definition> Array_element::ASTgen_definition() const
+  // the omitted bounds of a triplet are the bounds of the array, and the omitted stride is 1
+  std::vector<ast::Section_subscript> Array_element::ASTgen_section_subscripts(const ast::Shape &shape) const
   {
-    std::shared_ptr<ast::Variable> var = get_or_create_var(this->name);
+    std::vector<ast::Section_subscript> subscripts;
+    for (int i=0; i<shape.get_rank(); i++) {
+      ast::Section_subscript subscript;
+      auto *triplet = dynamic_cast<Subscript_triplet*>(this->subscripts[i].get());
+      if (!triplet) {
+        subscript.lower = ASTgen_section_index(*this->subscripts[i], this->name);
+        subscripts.push_back(std::move(subscript));
+        continue;
+      }
+      subscript.lower = triplet->get_lower() ? ASTgen_section_index(*triplet->get_lower(), this->name)
+        : convert_type(shape.get_lower_bound(i).get_copy(), ast::index_type_kind);
+      subscript.upper = triplet->get_upper() ? ASTgen_section_index(*triplet->get_upper(), this->name)
+        : convert_type(shape.get_upper_bound(i).get_copy(), ast::index_type_kind);
+      if (triplet->get_stride()) {
+        subscript.stride = ASTgen_section_index(*triplet->get_stride(), this->name);
+        constant_folder::fold_expression(subscript.stride);
+        if (subscript.stride->is_constant_int() && subscript.stride->eval_constant_value() == 0) {
+          semantic_error("stride of array section '" + this->name + "' is zero");
+        }
+      } else {
+        subscript.stride = std::make_unique<ast::Int64_constant>(1);
+      }
+      subscripts.push_back(std::move(subscript));
+    }
+    return subscripts;
+  }
+  std::unique_ptr<ast::Expression> Subscript_triplet::ASTgen() const
+  {
+    semantic_error("subscript triplet is only allowed in the subscripts of an array");
+    return std::make_unique<ast::Int32_constant>(0);
+  }
+  std::unique_ptr<ast::Variable_definition> Array_element::ASTgen_definition(bool is_defined) const
+  {
+    if (find_procedure(this->name)) {
+      semantic_error("procedure '" + this->name + "' cannot be defined");
+    }
+    std::shared_ptr<ast::Variable> var = get_or_create_var(this->name, is_defined);
+    if (!var->is_array() || var->get_shape().get_rank() != this->subscripts.size()) {
+      semantic_error("'" + this->name + "' is not an array of rank " + std::to_string(this->subscripts.size()));
+      return std::make_unique<ast::Variable_definition>(var);
+    }
+    if (this->is_section()) {
+      if (!var->is_array()) {
+        semantic_error("'" + this->name + "' is not an array");
+        return std::make_unique<ast::Variable_definition>(var);
+      }
+      auto section = std::make_unique<ast::Array_section_definition>(var, this->ASTgen_section_subscripts(var->get_shape()));
+      section->set_line_num(this->line_num);
+      section->fold_operands();
+      return static_unique_pointer_cast<ast::Variable_definition>(std::move(section));
+    }
     std::vector<std::unique_ptr<ast::Expression>> indices;
     const ast::Shape &shape = var->get_shape();
     for (int i=0; i<shape.get_rank(); i++) {
-      auto lower = std::make_unique<ast::Int32_constant>(shape.get_lower_bound(i).eval_constant_value());
-      auto index = std::make_unique<ast::Binary_op>(ast::binary_op_kind::sub,
-                                                    this->subscripts[i]->ASTgen(),
-                                                    std::move(lower));
-      indices.push_back(std::move(index));
+      indices.push_back(this->subscripts[i]->ASTgen());
     }
     auto elm_def = std::make_unique<ast::Array_element_definition>(var, std::move(indices));
+    elm_def->set_line_num(this->line_num);
     return static_unique_pointer_cast<ast::Variable_definition>(std::move(elm_def));
   }
+  int64_t get_element_index(const ast::Array_element_reference &element, const ast::Shape &shape);
+
+  // variables, array elements and sections are passed by reference, so they are definitions
+  // when the procedure may define them. Other expressions are passed in a temporary
+  std::vector<std::unique_ptr<ast::Expression>> ASTgen_actual_arguments(const std::vector<std::unique_ptr<Expression>> &args,
+                                                                        bool is_call)
+  {
+    std::vector<std::unique_ptr<ast::Expression>> actuals;
+    for (auto &arg : args) {
+      auto *var = dynamic_cast<const Variable*>(arg.get());
+      if (var && !find_named_constant(var->get_name()) && !find_procedure(var->get_name())) {
+        actuals.push_back(var->ASTgen_definition(is_call));
+      } else {
+        actuals.push_back(arg->ASTgen());
+      }
+    }
+    return actuals;
+  }
+
+  // elements of the storage an actual argument passes to an array dummy argument, -1 when it is not known
+  int64_t get_actual_size(const ast::Expression &actual)
+  {
+    if (auto *element = dynamic_cast<const ast::Array_element_reference*>(&actual)) {
+      // sequence association, from the element to the end of the array
+      const ast::Shape &shape = element->get_shape();
+      int64_t index = get_element_index(*element, shape);
+      return index < 0 ? -1 : shape.get_size() - index;
+    }
+    if (auto *section = dynamic_cast<const ast::Array_section*>(&actual)) {
+      ast::Array_view view;
+      if (!section->get_view(view)) return -1;
+      int64_t size = 1;
+      for (int64_t extent : view.extents) size *= extent;
+      return size;
+    }
+    return actual.get_shape().get_size();
+  }
+
+  // the dummy arguments are explicit-shape arrays and scalars of the same type as the actual ones.
+  // nothing is known about the dummy arguments of a procedure of another file
+  void check_actual_arguments(const ast::Program_unit &procedure, const std::vector<std::unique_ptr<ast::Expression>> &actuals)
+  {
+    std::string name = procedure.get_name();
+    for (int i=0; i<actuals.size(); i++) {
+      const ast::Expression &actual = *actuals[i];
+      std::string arg = "argument " + std::to_string(i+1) + " of '" + name + "'";
+      auto *ref = dynamic_cast<const ast::Variable_reference*>(&actual);
+      if (ref && !ref->get_type()) {
+        semantic_error("type of '" + ref->get_var_name() + "' in " + arg + " is not declared");
+        return;
+      }
+      if (actual.get_type_kind() == ast::Type_kind::character) {
+        semantic_error("character " + arg + " is not supported");
+        return;
+      }
+      if (actual.is_array() && !ref && !dynamic_cast<const ast::Array_constructor*>(&actual)) {
+        semantic_error("array expression in " + arg + " is not supported");
+        return;
+      }
+    }
+    if (procedure.is_interface_only()) return;
+    const std::vector<std::shared_ptr<ast::Variable>> &dummies = procedure.get_dummy_arguments();
+    if (actuals.size() != dummies.size()) {
+      semantic_error("'" + name + "' takes " + std::to_string(dummies.size()) + " arguments, " +
+                     std::to_string(actuals.size()) + " given");
+      return;
+    }
+    for (int i=0; i<actuals.size(); i++) {
+      const ast::Expression &actual = *actuals[i];
+      const ast::Variable &dummy = *dummies[i];
+      std::string arg = "argument " + std::to_string(i+1) + " of '" + name + "'";
+      if (actual.get_type_kind() != dummy.get_type_kind()) {
+        semantic_error("type mismatch in " + arg);
+        continue;
+      }
+      auto *element = dynamic_cast<const ast::Array_element_reference*>(&actual);
+      if (!dummy.is_array()) {
+        if (actual.is_array()) semantic_error(arg + " is an array, the dummy argument is a scalar");
+        continue;
+      }
+      if (!actual.is_array() && !element) {
+        semantic_error(arg + " is a scalar, the dummy argument is an array");
+        continue;
+      }
+      auto *section = dynamic_cast<const ast::Array_section*>(&actual);
+      if (section && !section->is_contiguous()) {
+        semantic_error("array section in " + arg + " is not contiguous, it is not copied");
+        continue;
+      }
+      int64_t size = get_actual_size(actual);
+      if (size >= 0 && size < dummy.get_shape().get_size()) {
+        semantic_error(arg + " has " + std::to_string(size) + " elements, fewer than the dummy argument");
+        continue;
+      }
+      // a padded array is passed only as a whole to a dummy argument of the same shape, so both have the same padding
+      auto *ref = dynamic_cast<const ast::Variable_reference*>(&actual);
+      const ast::Shape &storage_shape = ref ? ref->Variable_reference::get_shape() : actual.get_shape();
+      if (options.pad_arrays && (dummy.get_shape().is_padded() || storage_shape.is_padded()) &&
+          (element || section || !is_conformable(storage_shape, dummy.get_shape()))) {
+        semantic_error("padded array in " + arg + " is not passed as a whole array of the same shape");
+      }
+    }
+  }
+
   std::unique_ptr<ast::Expression> Variable::ASTgen() const
   {
+    if (const ast::Expression *named_constant = find_named_constant(this->name)) {
+      return named_constant->get_copy();
+    }
     std::shared_ptr<ast::Variable> var = get_or_create_var(this->name);
     std::unique_ptr<ast::Variable_reference> var_ref { new ast::Variable_reference(var) };
     return static_unique_pointer_cast<ast::Expression>(std::move(var_ref));
   }
   std::unique_ptr<ast::Expression> Array_element::ASTgen() const
   {
+    if (std::shared_ptr<ast::Program_unit> function = find_procedure(this->name)) {
+      if (function->get_kind() != ast::Program_unit_kind::function) {
+        semantic_error("subroutine '" + this->name + "' is referenced as a function");
+        return std::make_unique<ast::Int32_constant>(0);
+      }
+      std::vector<std::unique_ptr<ast::Expression>> args = ASTgen_actual_arguments(this->subscripts, false);
+      check_actual_arguments(*function, args);
+      current_program_unit->add_callee(function.get());
+      auto function_ref = std::make_unique<ast::Function_reference>(function.get(), std::move(args));
+      function_ref->set_line_num(this->line_num);
+      return function_ref;
+    }
     std::shared_ptr<ast::Variable> var = get_or_create_var(this->name);
+    if (!var->is_array() || var->get_shape().get_rank() != this->subscripts.size()) {
+      semantic_error("'" + this->name + "' is not a function or an array of rank " + std::to_string(this->subscripts.size()));
+      return std::make_unique<ast::Int32_constant>(0);
+    }
+    if (this->is_section()) {
+      if (!var->is_array()) {
+        semantic_error("'" + this->name + "' is not an array");
+        return std::make_unique<ast::Variable_reference>(var);
+      }
+      auto section = std::make_unique<ast::Array_section>(var, this->ASTgen_section_subscripts(var->get_shape()));
+      section->set_line_num(this->line_num);
+      section->fold_operands();
+      return static_unique_pointer_cast<ast::Expression>(std::move(section));
+    }
     std::vector<std::unique_ptr<ast::Expression>> indices;
     const ast::Shape &shape = var->get_shape();
     for (int i=0; i<shape.get_rank(); i++) {
-      auto lower = std::make_unique<ast::Int32_constant> (shape.get_lower_bound(i).eval_constant_value());
-      auto index = std::make_unique<ast::Binary_op>(ast::binary_op_kind::sub,
-                                                    this->subscripts[i]->ASTgen(),
-                                                    std::move(lower));
-      indices.push_back(std::move(index));
+      indices.push_back(this->subscripts[i]->ASTgen());
     }
     auto elm_ref = std::make_unique<ast::Array_element_reference>(var, std::move(indices));
+    elm_ref->set_line_num(this->line_num);
     return static_unique_pointer_cast<ast::Expression>(std::move(elm_ref));
   }
   std::unique_ptr<ast::Expression> Constant::ASTgen() const
   {
     if (this->type_kind == Type_kind::Intrinsic) {
       if (this->type_name == "integer") {
-        auto cnt = std::make_unique<ast::Int32_constant>(std::stoi(this->value));
+        int64_t value = std::stoll(this->value);
+        if (value > INT32_MAX) {
+          auto cnt = std::make_unique<ast::Int64_constant>(value);
+          return static_unique_pointer_cast<ast::Expression>(std::move(cnt));
+        }
+        auto cnt = std::make_unique<ast::Int32_constant>(value);
         return static_unique_pointer_cast<ast::Expression>(std::move(cnt));
       } else if (this->type_name == "real") {
         auto cnt = std::make_unique<ast::FP32_constant>(std::strtod(this->value.c_str(), nullptr));
@@ -106,6 +444,92 @@ namespace cst {
     }
     return nullptr;
   }
+  void Array_constructor::ASTgen_list(std::vector<std::unique_ptr<ast::Expression>> &values) const
+  {
+    for (auto &value : this->values) {
+      value->ASTgen_list(values);
+    }
+  }
+  std::unique_ptr<ast::Expression> Array_constructor::ASTgen() const
+  {
+    std::vector<std::unique_ptr<ast::Expression>> elements;
+    this->ASTgen_list(elements);
+    if (elements.size() == 0) {
+      semantic_error("empty array constructor is not supported");
+      return std::make_unique<ast::Int32_constant>(0);
+    }
+    ast::Type_kind kind = elements[0]->get_type_kind();
+    for (auto &element : elements) {
+      if (element->is_array()) {
+        semantic_error("array value in array constructor is not supported");
+        return std::make_unique<ast::Int32_constant>(0);
+      }
+      if (element->get_type_kind() != kind) {
+        semantic_error("type mismatch in array constructor");
+        return std::make_unique<ast::Int32_constant>(0);
+      }
+    }
+    if (kind == ast::Type_kind::character) {
+      semantic_error("character array constructor is not supported");
+      return std::make_unique<ast::Int32_constant>(0);
+    }
+    return std::make_unique<ast::Array_constructor>(std::move(elements));
+  }
+
+  // the integer value of a constant expression, false when it is not one
+  bool eval_integer_constant(const Expression &expr, int64_t &value)
+  {
+    std::unique_ptr<ast::Expression> ast_expr = expr.ASTgen();
+    constant_folder::fold_expression(ast_expr);
+    if (!dynamic_cast<ast::Constant*>(ast_expr.get()) || !ast::is_integer_kind(ast_expr->get_type_kind())) {
+      return false;
+    }
+    value = ast_expr->eval_constant_value();
+    return true;
+  }
+
+  // the values are generated for every iteration with the do-variable bound like a named constant
+  void Implied_do::ASTgen_list(std::vector<std::unique_ptr<ast::Expression>> &values) const
+  {
+    int64_t start, end, stride = 1;
+    if (!eval_integer_constant(*this->start_expr, start) || !eval_integer_constant(*this->end_expr, end) ||
+        (this->stride_expr && !eval_integer_constant(*this->stride_expr, stride))) {
+      semantic_error("bounds of implied-DO '" + this->do_variable + "' are not constant");
+      return;
+    }
+    if (stride == 0) {
+      semantic_error("stride of implied-DO '" + this->do_variable + "' is zero");
+      return;
+    }
+    auto var = current_variable_table->find(this->do_variable);
+    bool is_i64 = var != current_variable_table->end() && var->second && var->second->get_type() &&
+      var->second->get_type_kind() == ast::Type_kind::i64;
+    std::map<std::string, std::unique_ptr<ast::Expression>> &named_constants = current_scope->named_constants;
+    std::unique_ptr<ast::Expression> saved;
+    auto bound = named_constants.find(this->do_variable);
+    if (bound != named_constants.end()) saved = std::move(bound->second);
+    for (int64_t i = start; stride > 0 ? i <= end : i >= end; i += stride) {
+      if (is_i64) {
+        named_constants[this->do_variable] = std::make_unique<ast::Int64_constant>(i);
+      } else {
+        named_constants[this->do_variable] = std::make_unique<ast::Int32_constant>(i);
+      }
+      for (auto &value : this->values) {
+        value->ASTgen_list(values);
+      }
+    }
+    if (saved) {
+      named_constants[this->do_variable] = std::move(saved);
+    } else {
+      named_constants.erase(this->do_variable);
+    }
+  }
+  std::unique_ptr<ast::Expression> Implied_do::ASTgen() const
+  {
+    semantic_error("implied-DO is only allowed in array constructors and DATA statements");
+    return std::make_unique<ast::Int32_constant>(0);
+  }
+
   std::unique_ptr<ast::Expression> Operator::ASTgen() const
   {
     std::unique_ptr<ast::Expression> exp = nullptr;
@@ -139,17 +563,11 @@ namespace cst {
         std::unique_ptr<ast::Expression> lhs = exp ? std::move(exp) : this->operands[i]->ASTgen();
         std::unique_ptr<ast::Expression> rhs = this->operands[i+1]->ASTgen();
         if (lhs->get_type_kind() != rhs->get_type_kind()) {
-          // cast
-          if (lhs->get_type_kind() == ast::Type_kind::fp32 &&
-              rhs->get_type_kind() == ast::Type_kind::i32) {
-            rhs = std::make_unique<ast::Unary_op>(ast::unary_op_kind::i32tofp32, std::move(rhs));
-          } else if (lhs->get_type_kind() == ast::Type_kind::i32 &&
-                     rhs->get_type_kind() == ast::Type_kind::fp32) {
-            lhs = std::make_unique<ast::Unary_op>(ast::unary_op_kind::i32tofp32, std::move(lhs));
-          } else {
-            // error message should be output
-            assert(0);
-          }
+          // cast to the stronger type
+          ast::Type_kind kind = get_type_rank(lhs->get_type_kind()) > get_type_rank(rhs->get_type_kind()) ?
+            lhs->get_type_kind() : rhs->get_type_kind();
+          lhs = convert_type(std::move(lhs), kind);
+          rhs = convert_type(std::move(rhs), kind);
         }
         exp = std::make_unique<ast::Binary_op>(op, std::move(lhs), std::move(rhs));
       }
@@ -163,31 +581,41 @@ namespace cst {
 
   std::unique_ptr<ast::Statement> Do_with_do_variable::ASTgen() const
   {
-    auto initial_expr = std::make_unique<ast::Assignment_statement>(this->do_variable->ASTgen_definition(),
-                                                                    this->start_expr->ASTgen());
+    std::unique_ptr<ast::Variable_definition> do_variable = this->do_variable->ASTgen_definition();
+    ast::Type_kind kind = do_variable->get_type_kind();
+    std::unique_ptr<ast::Expression> start = convert_type(this->start_expr->ASTgen(), kind);
+    std::unique_ptr<ast::Expression> end = convert_type(this->end_expr->ASTgen(), kind);
+    std::unique_ptr<ast::Expression> stride;
+    if (this->stride_expr) {
+      stride = convert_type(this->stride_expr->ASTgen(), kind);
+    } else {
+      stride = convert_type(std::make_unique<ast::Int32_constant>(1), kind);
+    }
 
-    std::unique_ptr<ast::Assignment_statement> increment_expr;
+    // iteration count is max((end-start+stride)/stride, 0)
+    // the clamp to 0 is done by ast::Do_construct
+    std::unique_ptr<ast::Expression> trip_count_expr;
     {
-      std::unique_ptr<ast::Expression> increment_val;
-      if (this->stride_expr) {
-        increment_val = this->stride_expr->ASTgen();
-      } else {
-        increment_val = std::make_unique<ast::Int32_constant>(1);
-      }
-      auto increment_expr_rhs = std::make_unique<ast::Binary_op>(ast::binary_op_kind::add,
-                                                                 this->do_variable->ASTgen(),
-                                                                 std::move(increment_val));
-      increment_expr = std::make_unique<ast::Assignment_statement>(this->do_variable->ASTgen_definition(),
-                                                                   std::move(increment_expr_rhs));
+      auto distance = std::make_unique<ast::Binary_op>(ast::binary_op_kind::sub,
+                                                       end->get_copy(),
+                                                       start->get_copy());
+      auto numerator = std::make_unique<ast::Binary_op>(ast::binary_op_kind::add,
+                                                        std::move(distance),
+                                                        stride->get_copy());
+      trip_count_expr = std::make_unique<ast::Binary_op>(ast::binary_op_kind::div,
+                                                         std::move(numerator),
+                                                         stride->get_copy());
     }
 
-    auto condition_expr = std::make_unique<ast::Binary_op>(ast::binary_op_kind::le,
-                                                           this->do_variable->ASTgen(),
-                                                           this->end_expr->ASTgen());
-    return std::make_unique<ast::Do_construct> (std::move(initial_expr),
-                                                std::move(increment_expr),
-                                                std::move(condition_expr),
-                                                this->block->ASTgen());
+    auto do_construct = std::make_unique<ast::Do_construct> (std::move(do_variable),
+                                                             std::move(start),
+                                                             std::move(end),
+                                                             std::move(stride),
+                                                             std::move(trip_count_expr),
+                                                             this->block->ASTgen());
+    do_construct->set_line_num(this->line_num);
+    do_construct->set_directives(this->directives);
+    return std::move(do_construct);
   }
 
   std::unique_ptr<ast::Block> Block::ASTgen() const
@@ -201,36 +629,246 @@ namespace cst {
   
   std::unique_ptr<ast::Statement> Assignment_statement::ASTgen() const
   {
-    return std::make_unique<ast::Assignment_statement>(this->lhs->ASTgen_definition(),
-                                                       this->rhs->ASTgen());
+    std::unique_ptr<ast::Variable_definition> lhs = this->lhs->ASTgen_definition();
+    std::unique_ptr<ast::Expression> rhs = this->rhs->ASTgen();
+    if (lhs->is_array() && (lhs->has_function_reference() || rhs->has_function_reference())) {
+      semantic_error("function reference in the array assignment to '" + lhs->get_var_name() + "' is not supported");
+    }
+    if (dynamic_cast<ast::Array_constructor*>(rhs.get()) &&
+        (!lhs->is_array() || lhs->get_shape().get_rank() != 1 ||
+         lhs->get_shape().get_size() != rhs->get_shape().get_size())) {
+      semantic_error("array constructor of " + std::to_string(rhs->get_shape().get_size()) +
+                     " elements is not conformable with '" + lhs->get_var_name() + "'");
+    }
+    if ((lhs->has_section() || rhs->has_section()) &&
+        ((rhs->is_array() && !lhs->is_array()) ||
+         (rhs->is_array() && !is_conformable(lhs->get_shape(), rhs->get_shape())))) {
+      semantic_error("array section in the assignment to '" + lhs->get_var_name() + "' is not conformable");
+    }
+    if (lhs->get_type_kind() != rhs->get_type_kind() &&
+        lhs->get_type_kind() != ast::Type_kind::logical &&
+        lhs->get_type_kind() != ast::Type_kind::character) {
+      rhs = convert_type(std::move(rhs), lhs->get_type_kind());
+    }
+    return std::make_unique<ast::Assignment_statement>(std::move(lhs), std::move(rhs));
   }
   
-  std::shared_ptr<ast::Program_unit> Program::ASTgen() const
+  // -fpad-arrays: with a leading extent that is a multiple of 64 elements, the columns
+  // start at the same cache sets. 16 more elements per column spread them over the
+  // sets and keep the columns 64-byte aligned. The padding depends on the extents
+  // only, so conformable arrays keep the same storage layout
+  void pad_leading_dimensions()
+  {
+    for (auto &entry : *current_variable_table) {
+      std::shared_ptr<ast::Variable> var = entry.second;
+      if (!var->is_array() || var->get_type_kind() == ast::Type_kind::character) continue;
+      ast::Shape &shape = var->get_shape();
+      if (shape.get_rank() >= 2 && shape.get_size(0) % 64 == 0) {
+        shape.set_padding(16);
+      }
+    }
+  }
+
+  // explicit-shape arrays and scalars of a declared type, the storage is the one of the actual argument
+  void ASTgen_dummy_argument(std::string name)
+  {
+    auto entry = current_variable_table->find(name);
+    if (entry == current_variable_table->end() || !entry->second || !entry->second->get_type()) {
+      semantic_error("type of dummy argument '" + name + "' is not declared");
+      return;
+    }
+    std::shared_ptr<ast::Variable> var = entry->second;
+    if (var->get_type_kind() == ast::Type_kind::character) {
+      semantic_error("character dummy argument '" + name + "' is not supported");
+      return;
+    }
+    if (var->has_initial_values()) {
+      semantic_error("dummy argument '" + name + "' cannot be initialized by a data-stmt");
+      return;
+    }
+    if (var->is_array()) {
+      const ast::Shape &shape = var->get_shape();
+      for (int i=0; i<shape.get_rank(); i++) {
+        if (!shape.get_lower_bound(i).is_constant_int() || !shape.get_upper_bound(i).is_constant_int()) {
+          semantic_error("adjustable array '" + name + "' is not supported");
+          return;
+        }
+      }
+    }
+    var->set_dummy();
+    current_program_unit->add_dummy_argument(var);
+  }
+
+  void Program::ASTgen_specification_part() const
   {
-    current_program_unit = std::make_shared<ast::Program_unit>(this->name);
-    current_variable_table = std::make_unique<std::map<std::string, std::shared_ptr<ast::Variable>>>();
-    current_type_table = std::make_unique<std::map<std::string, std::shared_ptr<ast::Type>>>();
     for (auto &spec : this->specifications) {
       spec->ASTgen(current_program_unit);
     }
+    for (auto &name : this->dummy_arguments) {
+      ASTgen_dummy_argument(name);
+    }
+    if (this->kind == Program_kind::function) {
+      auto result = current_variable_table->find(this->result_name);
+      if (result == current_variable_table->end() || !result->second || !result->second->get_type()) {
+        semantic_error("type of the result of function '" + this->name + "' is not declared");
+      } else if (result->second->is_array() || result->second->get_type_kind() == ast::Type_kind::character) {
+        semantic_error("result of function '" + this->name + "' is not a scalar of a numeric or logical type");
+      } else {
+        current_program_unit->set_result(result->second);
+      }
+    }
+    // the strides have to be known before any array element is referenced
+    if (options.pad_arrays) pad_leading_dimensions();
+  }
+
+  void Program::ASTgen_execution_part() const
+  {
     for (auto &exec : this->executable_constructs) {
       current_program_unit->add_statement(exec->ASTgen());
     }
-    current_program_unit->set_variables(std::move(current_variable_table));
-    current_program_unit->set_types(std::move(current_type_table));
-    
-    return current_program_unit;
   }
 
-  std::shared_ptr<ast::Type> get_or_create_type(cst::Type_kind type_kind, std::string type_name)
+  Scope *create_scope(const Program &program, Scope *host)
+  {
+    ast::Program_unit_kind kind = ast::Program_unit_kind::main_program;
+    if (program.get_kind() == Program_kind::subroutine) {
+      kind = ast::Program_unit_kind::subroutine;
+    } else if (program.get_kind() == Program_kind::function) {
+      kind = ast::Program_unit_kind::function;
+    }
+    auto scope = std::make_unique<Scope>();
+    scope->program = &program;
+    scope->unit = std::make_shared<ast::Program_unit>(program.get_name(), kind);
+    scope->host = host;
+    if (host) {
+      if (host->procedures.count(program.get_name())) {
+        semantic_error("internal subprogram '" + program.get_name() + "' is defined twice");
+      }
+      host->procedures[program.get_name()] = scope->unit;
+      host->unit->add_internal_program(scope->unit);
+      scope->unit->set_host(host->unit.get());
+    }
+    scopes.push_back(std::move(scope));
+    return scopes.back().get();
+  }
+
+  void enter_scope(Scope *scope)
+  {
+    current_scope = scope;
+    current_program_unit = scope->unit;
+    current_variable_table = &scope->unit->get_variables();
+    current_type_table = &scope->unit->get_types();
+  }
+
+  // the scopes of all the program units are made first, so that a subprogram can be referenced
+  // before it is defined. The specification parts come before the execution parts, which
+  // need the dummy arguments of the subprograms they call
+  std::shared_ptr<ast::Program_unit> Program::ASTgen(const Compile_options &opts) const
+  {
+    options = opts;
+    semantic_error_occured = false;
+    scopes.clear();
+    external_procedures.clear();
+    Scope *root = create_scope(*this, nullptr);
+    for (auto &subprogram : this->internal_subprograms) {
+      create_scope(*subprogram, root);
+    }
+    for (auto &subprogram : this->external_subprograms) {
+      if (external_procedures.count(subprogram->get_name())) {
+        semantic_error("external subprogram '" + subprogram->get_name() + "' is defined twice");
+      }
+      Scope *scope = create_scope(*subprogram, nullptr);
+      external_procedures[subprogram->get_name()] = scope->unit;
+      root->unit->add_external_program(scope->unit);
+      for (auto &internal_subprogram : subprogram->get_internal_subprograms()) {
+        create_scope(*internal_subprogram, scope);
+      }
+    }
+    host_association_enabled = false;
+    for (int i=0; i<scopes.size(); i++) {
+      enter_scope(scopes[i].get());
+      scopes[i]->program->ASTgen_specification_part();
+    }
+    host_association_enabled = true;
+    for (int i=0; i<scopes.size(); i++) {
+      enter_scope(scopes[i].get());
+      scopes[i]->program->ASTgen_execution_part();
+    }
+    // a call of an internal subprogram defines the variables of the host it defines
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (auto &scope : scopes) {
+        ast::Program_unit &unit = *scope->unit;
+        for (const ast::Program_unit *callee : unit.get_callees()) {
+          if (!unit.get_host() || callee->get_host() != unit.get_host()) continue;
+          for (std::string name : callee->get_host_definitions()) {
+            if (unit.get_host_definitions().count(name)) continue;
+            unit.add_host_definition(name);
+            changed = true;
+          }
+        }
+      }
+    }
+    // a function reference has no side effects, the expressions are analyzed as if it is a value
+    for (auto &scope : scopes) {
+      const ast::Program_unit &unit = *scope->unit;
+      if (unit.get_kind() != ast::Program_unit_kind::function) continue;
+      for (std::string name : unit.get_host_definitions()) {
+        semantic_error("function '" + unit.get_name() + "' defines host variable '" + name + "'");
+      }
+    }
+    std::shared_ptr<ast::Program_unit> program = root->unit;
+    scopes.clear();
+    if (semantic_error_occured) return nullptr;
+    return program;
+  }
+
+  // a subprogram not defined in the file is an external subroutine of another file
+  std::unique_ptr<ast::Statement> Call_statement::ASTgen() const
+  {
+    std::shared_ptr<ast::Program_unit> subroutine = find_procedure(this->name);
+    if (!subroutine) {
+      auto var = current_variable_table->find(this->name);
+      if ((var != current_variable_table->end() && var->second) || find_named_constant(this->name)) {
+        semantic_error("'" + this->name + "' is not a subroutine");
+        return std::make_unique<ast::Return_statement>();
+      }
+      subroutine = std::make_shared<ast::Program_unit>(this->name, ast::Program_unit_kind::subroutine);
+      subroutine->set_interface_only();
+      external_procedures[this->name] = subroutine;
+      scopes[0]->unit->add_external_program(subroutine);
+    } else if (subroutine->get_kind() != ast::Program_unit_kind::subroutine) {
+      semantic_error("function '" + this->name + "' is called by a call-stmt");
+    }
+    std::vector<std::unique_ptr<ast::Expression>> args = ASTgen_actual_arguments(this->args, true);
+    check_actual_arguments(*subroutine, args);
+    current_program_unit->add_callee(subroutine.get());
+    return std::make_unique<ast::Call_statement>(subroutine.get(), std::move(args), this->line_num);
+  }
+
+  std::unique_ptr<ast::Statement> Return_statement::ASTgen() const
   {
-    if ((*current_type_table)[type_name]) {
-      return (*current_type_table)[type_name];
+    if (current_program_unit->get_kind() == ast::Program_unit_kind::main_program) {
+      semantic_error("return-stmt in the main program");
+    }
+    return std::make_unique<ast::Return_statement>();
+  }
+
+  std::shared_ptr<ast::Type> get_or_create_type(cst::Type_kind type_kind, std::string type_name, int kind_param)
+  {
+    std::string key = type_name;
+    if (kind_param) {
+      key += "(" + std::to_string(kind_param) + ")";
+    }
+    if ((*current_type_table)[key]) {
+      return (*current_type_table)[key];
     }
     
     assert(type_kind == cst::Type_kind::Intrinsic);
     std::shared_ptr<ast::Type> result;
-    if (type_name == "integer") {
+    if (type_name == "integer" && kind_param == 8) {
+      result = std::make_shared<ast::Type>(ast::Type_kind::i64);
+    } else if (type_name == "integer") {
       result = std::make_shared<ast::Type>(ast::Type_kind::i32);
     } else if (type_name == "real") {
       result = std::make_shared<ast::Type>(ast::Type_kind::fp32);
@@ -239,7 +877,7 @@ namespace cst {
     } else if (type_name == "character") {
       result = std::make_shared<ast::Type>(ast::Type_kind::character);
     }
-    (*current_type_table)[type_name] = result;
+    (*current_type_table)[key] = result;
     return result;
   }
 
@@ -264,7 +902,7 @@ namespace cst {
   
   void Type_specification::ASTgen(std::shared_ptr<ast::Program_unit> program) const
   {
-    std::shared_ptr<ast::Type> type = get_or_create_type(this->type_kind, this->type_name);
+    std::shared_ptr<ast::Type> type = get_or_create_type(this->type_kind, this->type_name, this->kind_param);
     for (std::string name : this->variables) {
       std::shared_ptr<ast::Variable> var = get_or_create_var(name);
       var->set_type(type);
@@ -276,6 +914,147 @@ namespace cst {
         }
       }
     }
+    for (auto &def : this->named_constants) {
+      def->ASTgen();
+    }
+  }
+
+  // the value is folded here, so shapes, loop bounds and expressions see a constant
+  void Named_constant_definition::ASTgen() const
+  {
+    auto var = current_variable_table->find(this->named_constant);
+    if (var == current_variable_table->end() || !var->second->get_type()) {
+      semantic_error("type of named constant '" + this->named_constant + "' is not declared");
+      return;
+    }
+    if (var->second->is_array()) {
+      semantic_error("array named constant '" + this->named_constant + "' is not supported");
+      return;
+    }
+    ast::Type_kind kind = var->second->get_type_kind();
+    std::unique_ptr<ast::Expression> value = this->expr->ASTgen();
+    ast::Type_kind value_kind = value->get_type_kind();
+    if (value_kind != kind) {
+      // only the numeric conversions of an assignment, real to integer is not supported
+      bool is_numeric = kind != ast::Type_kind::logical && kind != ast::Type_kind::character &&
+        value_kind != ast::Type_kind::logical && value_kind != ast::Type_kind::character;
+      if (!is_numeric || value_kind == ast::Type_kind::fp32) {
+        semantic_error("type mismatch in the value of named constant '" + this->named_constant + "'");
+        return;
+      }
+      value = convert_type(std::move(value), kind);
+    }
+    constant_folder::fold_expression(value);
+    if (!dynamic_cast<ast::Constant*>(value.get())) {
+      semantic_error("value of named constant '" + this->named_constant + "' is not a constant expression");
+      return;
+    }
+    // no storage is allocated for it
+    current_variable_table->erase(var);
+    current_scope->named_constants[this->named_constant] = std::move(value);
+  }
+
+  // the column-major index of an element at constant subscripts, -1 when it is not one
+  int64_t get_element_index(const ast::Array_element_reference &element, const ast::Shape &shape)
+  {
+    int64_t index = 0;
+    int64_t size = 1;
+    for (int i=0; i<shape.get_rank(); i++) {
+      std::unique_ptr<ast::Expression> subscript = element.get_indices()[i]->get_copy();
+      constant_folder::fold_expression(subscript);
+      if (!dynamic_cast<ast::Constant*>(subscript.get()) || !ast::is_integer_kind(subscript->get_type_kind())) {
+        return -1;
+      }
+      int64_t offset = subscript->eval_constant_value() - shape.get_lower_bound(i).eval_constant_value();
+      if (offset < 0 || offset >= shape.get_size(i)) return -1;
+      index += offset * size;
+      size *= shape.get_size(i);
+    }
+    return index;
+  }
+
+  // the values are stored in the variables as the initial values of their storage
+  void Data_statement_set::ASTgen() const
+  {
+    std::vector<std::unique_ptr<ast::Expression>> values;
+    for (int i=0; i<this->values.size(); i++) {
+      std::unique_ptr<ast::Expression> value = this->values[i]->ASTgen();
+      constant_folder::fold_expression(value);
+      if (!dynamic_cast<ast::Constant*>(value.get())) {
+        semantic_error("value in data-stmt is not a constant");
+        return;
+      }
+      for (int64_t j=0; j<this->repeats[i]; j++) {
+        values.push_back(value->get_copy());
+      }
+    }
+    std::vector<std::unique_ptr<ast::Expression>> objects;
+    for (auto &object : this->objects) {
+      object->ASTgen_list(objects);
+    }
+    int next = 0;
+    for (auto &object : objects) {
+      auto *ref = dynamic_cast<ast::Variable_reference*>(object.get());
+      if (!ref || !ref->get_type()) {
+        semantic_error("data-stmt object is not a variable of a declared type");
+        return;
+      }
+      std::shared_ptr<ast::Variable> var = (*current_variable_table)[ref->get_var_name()];
+      ast::Type_kind kind = var->get_type_kind();
+      if (kind == ast::Type_kind::character) {
+        semantic_error("data-stmt for character variable '" + var->get_name() + "' is not supported");
+        return;
+      }
+      if (ref->has_section()) {
+        semantic_error("array section of '" + var->get_name() + "' in data-stmt is not supported");
+        return;
+      }
+      int64_t first = 0;
+      int64_t count = var->is_array() ? var->get_shape().get_size() : 1;
+      if (auto *element = dynamic_cast<ast::Array_element_reference*>(ref)) {
+        first = get_element_index(*element, var->get_shape());
+        count = 1;
+        if (first < 0) {
+          semantic_error("subscripts of '" + var->get_name() + "' in data-stmt are not constant or out of bounds");
+          return;
+        }
+      }
+      for (int64_t i=first; i<first+count; i++) {
+        if (next == values.size()) {
+          semantic_error("not enough values in data-stmt");
+          return;
+        }
+        std::unique_ptr<ast::Expression> value = std::move(values[next++]);
+        ast::Type_kind value_kind = value->get_type_kind();
+        if (value_kind != kind) {
+          if (kind == ast::Type_kind::logical || value_kind == ast::Type_kind::logical ||
+              value_kind == ast::Type_kind::character || value_kind == ast::Type_kind::fp32) {
+            semantic_error("type mismatch in data-stmt value for '" + var->get_name() + "'");
+            return;
+          }
+          value = convert_type(std::move(value), kind);
+          constant_folder::fold_expression(value);
+        }
+        var->set_initial_value(i, std::move(value));
+      }
+    }
+    if (next != values.size()) {
+      semantic_error("too many values in data-stmt");
+    }
+  }
+
+  void Data_statement::ASTgen(std::shared_ptr<ast::Program_unit> program) const
+  {
+    for (auto &set : this->sets) {
+      set->ASTgen();
+    }
+  }
+
+  void Parameter_statement::ASTgen(std::shared_ptr<ast::Program_unit> program) const
+  {
+    for (auto &def : this->named_constants) {
+      def->ASTgen();
+    }
   }
 
   std::unique_ptr<ast::Statement> Print_statement::ASTgen() const
@@ -287,6 +1066,51 @@ namespace cst {
     return static_unique_pointer_cast<ast::Statement>(std::move(ast_output_stmt));
   }
 
+  std::unique_ptr<ast::Statement> Where_construct::ASTgen() const
+  {
+    auto ast_where = std::make_unique<ast::Where_construct>();
+    const ast::Shape *shape = nullptr;
+    for (int i=0; i<this->masks.size(); i++) {
+      std::unique_ptr<ast::Expression> mask;
+      if (this->masks[i]) {
+        mask = this->masks[i]->ASTgen();
+        if (!mask->is_array() || mask->get_type_kind() != ast::Type_kind::logical) {
+          semantic_error("mask of WHERE is not a logical array");
+          return ast_where;
+        }
+        if (mask->has_section()) {
+          semantic_error("array section in WHERE is not supported");
+          return ast_where;
+        }
+        if (mask->has_function_reference()) {
+          semantic_error("function reference in WHERE is not supported");
+          return ast_where;
+        }
+        if (shape && !is_conformable(*shape, mask->get_shape())) {
+          semantic_error("masks of WHERE construct are not conformable");
+          return ast_where;
+        }
+        if (!shape) shape = &mask->get_shape();
+      }
+      ast_where->add_clause(std::move(mask));
+      for (auto &assignment : this->assignments[i]) {
+        auto stmt = static_unique_pointer_cast<ast::Assignment_statement>(assignment->ASTgen());
+        const ast::Variable_definition &lhs = stmt->get_lhs();
+        if (lhs.has_section() || stmt->get_rhs().has_section()) {
+          semantic_error("array section in WHERE is not supported");
+          return ast_where;
+        }
+        if (!lhs.is_array() || !is_conformable(*shape, lhs.get_shape()) ||
+            (stmt->get_rhs().is_array() && !is_conformable(*shape, stmt->get_rhs().get_shape()))) {
+          semantic_error("assignment to '" + lhs.get_var_name() + "' in WHERE is not conformable with the mask");
+          return ast_where;
+        }
+        ast_where->add_assignment(std::move(stmt));
+      }
+    }
+    return ast_where;
+  }
+
   // if文とif構文の違いはASTで吸収する予定
   std::unique_ptr<ast::Statement> If_statement::ASTgen() const
   {
@@ -0,0 +1,19 @@
+program main
+  integer i,j,a
+  real r
+  dimension a(3), r(2,2)
+  a = 0
+  print *,a(1)
+  print *,a(3)
+  a = 7
+  do i=1,3
+     print *,a(i)
+  end do
+  r = 1
+  r(2,1) = 2.5
+  do j=1,2
+     do i=1,2
+        print *,r(i,j)
+     end do
+  end do
+end program main
@@ -0,0 +1,9 @@
+0
+0
+7
+7
+7
+1.000000
+2.500000
+1.000000
+1.000000
@@ -0,0 +1,27 @@
+program main
+  integer i,a,b,c,s
+  real r
+  dimension a(2,2), b(2,2), c(2,2), r(2,2)
+  do i=1,2
+     a(i,1) = i
+     a(i,2) = i+2
+  end do
+  b = 10
+  s = 3
+  c = a*b + s
+  a = a + a*2
+  r = a / 2.0
+  do i=1,2
+     print *,c(i,1)
+     print *,c(i,2)
+     print *,a(i,1)
+     print *,a(i,2)
+     print *,r(i,2)
+  end do
+  ! the elements of a on the right are read before any element of a is defined
+  a = a + a(1,1)
+  print *, a(1,1), a(2,1), a(1,2), a(2,2)
+  c = a(2,1) * c
+  r = r(1,1) * 2.0 + r
+  print *, c(1,1), c(2,2), r(1,1), r(2,2)
+end program main
@@ -0,0 +1,18 @@
+13
+33
+3
+9
+4.500000
+23
+43
+6
+12
+6.000000
+6
+9
+12
+15
+117
+387
+4.500000
+9.000000
@@ -0,0 +1,13 @@
+program main
+  integer i,j,a
+  dimension a(0:2,2:3)
+  do j=2,3
+     do i=0,2
+        a(i,j) = i*10+j
+     end do
+  end do
+  print *,a(0,2)
+  print *,a(2,2)
+  print *,a(1,3)
+  print *,a(2,3)
+end program main
@@ -0,0 +1,4 @@
+2
+22
+13
+23
@@ -0,0 +1,16 @@
+program main
+  integer i,j,a
+  real b
+  dimension a(2000,2000), b(10)
+  a = 1
+  a(2000,2000) = 5
+  b = 2.5
+  j = 0
+  do i=1,2000
+     j = j + a(i,1000)
+  end do
+  print *,j
+  print *,a(1,1)
+  print *,a(2000,2000)
+  print *,b(10)
+end program main
@@ -0,0 +1,4 @@
+2000
+1
+5
+2.500000
@@ -0,0 +1,30 @@
+program main
+  integer, parameter :: n = 8
+  integer i, sq, t
+  real c, w, s
+  logical mask
+  dimension sq(n), c(4), w(4), t(2,3), mask(3)
+  data c /0.5, -1.25, 2.0, 3.0/
+  data t /6*0/, t(2,3) /7/
+  data mask /.true., 2*.false./
+  data s /1.5/
+  sq = [(i*i, i=1,n)]
+  w = (/ 1, 2, 3, 4 /)
+  w = w * c + [1.0, 1.0, 1.0, 1.0]
+  print *, sq(1), sq(n), sq(5)
+  print *, w(1), w(2), w(4)
+  print *, c(2), t(2,3), t(1,1), mask(1), mask(3), s
+  i = 3
+  w = [c(i), s, -c(1), 0.0]
+  print *, w(1), w(2), w(3)
+  c(4) = 9.0
+  print *, c(4)
+  ! the constructor is built once, before the loop
+  w = w * c + [s, c(1), s, c(4)]
+  print *, w(1), w(2), w(4)
+  ! logical constructors starting with a comparison
+  mask = [s > 0.0, .true., c(2) > 0.0]
+  print *, mask(1), mask(2), mask(3)
+  mask = [s < 0.0, c(1) > 0.0, s > c(1)]
+  print *, mask(1), mask(2), mask(3)
+end program main
@@ -0,0 +1,25 @@
+1
+64
+25
+1.500000
+-1.500000
+13.000000
+-1.250000
+7
+0
+T
+F
+1.500000
+2.000000
+1.500000
+-0.500000
+9.000000
+2.500000
+-1.375000
+9.000000
+T
+T
+F
+F
+T
+T
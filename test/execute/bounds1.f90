@@ -0,0 +1,41 @@
+program main
+  integer i, j, k, n, s, a, b
+  dimension a(10), b(10,10)
+  k = 1
+  k = k + 1
+  n = 10
+  a = 1
+  b = 0
+  ! stride known at run time, with a nested loop
+  do j=1,n,k
+     do i=1,n-j,k
+        b(i+j,j) = a(i) + i
+     end do
+  end do
+  s = 0
+  do j=1,n
+     do i=1,n
+        s = s + b(i,j)
+     end do
+  end do
+  print *, s
+  call shift(a)
+  print *, a(1), a(2), a(3), a(10)
+  ! sections with run-time subscripts, the last index of a(2:n+1:4*k) is 10
+  a(2:n+1:4*k) = a(k-1:k+1:k)
+  a(n+5:n) = 0
+  print *, a(2), a(10)
+  ! the element is read and checked once for the whole section
+  a(3:6) = a(k+8)
+  print *, a(3), a(6)
+contains
+  subroutine shift(v)
+    integer v, m
+    dimension v(10)
+    ! v(m+1) is out of bounds for m = 10, but the loop returns at m = 3
+    do m=1,10
+       if (v(m) < 0) return
+       v(m+1) = v(m) - 1
+    end do
+  end subroutine shift
+end program main
@@ -0,0 +1,9 @@
+70
+1
+0
+-1
+1
+1
+-1
+-1
+-1
@@ -0,0 +1,14 @@
+program main
+  integer i, k, n, a
+  dimension a(10)
+  k = 1
+  k = k + 1
+  n = 10
+  a = 0
+  print *, k
+  ! a(i+2) is out of bounds at the last iteration, i = 9
+  do i=1,n,k
+     a(i+2) = i
+  end do
+  print *, a(3)
+end program main
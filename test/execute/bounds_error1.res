@@ -0,0 +1,3 @@
+2
+bounds_error1.f90:11: runtime error: index 11 of dimension 1 of array 'a' is out of bounds 1:10
+exit status 1
@@ -0,0 +1,11 @@
+program main
+  integer j, n, a
+  dimension a(10)
+  n = 10
+  a = 0
+  j = n - 1
+  print *, j
+  ! the last index of the section, j+2, is out of bounds
+  a(j:j+2) = 1
+  print *, a(j)
+end program main
@@ -0,0 +1,3 @@
+9
+bounds_error2.f90:9: runtime error: index 11 of dimension 1 of array 'a' is out of bounds 1:10
+exit status 1
@@ -0,0 +1,35 @@
+program main
+  integer i,n,m,s
+  integer(8) k
+  real x,y
+  logical f,g
+  integer a
+  dimension a(100)
+  n = 10 * 10
+  m = n / 4
+  x = 1.5 * 2.0 - 0.5
+  y = x / 2.0
+  k = n * 1000000
+  f = x > y
+  g = 3 < 2
+  a = 0
+  s = 0
+  do i=1,n
+     a(i) = i + m
+  end do
+  do i=1,n
+     s = s + a(i)
+  end do
+  print *,s
+  print *,x
+  print *,y
+  print *,k
+  print *,f
+  print *,g
+  print *,2.0 * 3.0 > 5.0
+  if (f) print *,m
+  if (g) print *,n
+  i = 7
+  i = i + 1
+  print *,i * 2
+end program main
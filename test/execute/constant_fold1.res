@@ -0,0 +1,9 @@
+7550
+2.500000
+1.250000
+100000000
+T
+F
+T
+25
+16
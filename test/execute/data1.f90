@@ -0,0 +1,7 @@
+program main
+  integer i, a
+  dimension a(64, 2)
+  data a(64,1) /5/, (a(i,2), i=1,64,2) /32*3/
+  a(1,1) = 1
+  print *, a(64,1), a(1,2), a(2,2), a(63,2), a(1,1)
+end program main
@@ -0,0 +1,5 @@
+5
+3
+0
+3
+1
@@ -0,0 +1,47 @@
+program main
+  integer i,j,s
+  integer a,b,c
+  dimension a(1000), b(1000), c(100,100)
+  !dir$ vector always
+  do i=1,1000
+     a(i) = i
+  end do
+  !gcc$ ivdep
+  !dir$ unroll(4)
+  do i=1,1000
+     b(i) = a(i) * 2
+  end do
+  !dir$ novector
+  !dir$ nounroll
+  do i=1,1000
+     a(i) = a(i) + b(i)
+  end do
+  s = 0
+  !dir$ ivdep
+  do j=1,100
+     !gcc$ unroll 8
+     do i=1,100
+        c(i,j) = a(i) + j
+     end do
+  end do
+  !dir$ unroll
+  do i=1,1000
+     s = s + b(i)
+  end do
+  print *,a(1000)
+  print *,c(100,100)
+  print *,s
+  call total(b)
+  print *,s
+contains
+  subroutine total(v)
+    integer v, k
+    dimension v(1000)
+    ! s is static storage of the host, it is not free of dependences
+    s = 0
+    !dir$ ivdep
+    do k=1,1000
+       s = s + v(k)
+    end do
+  end subroutine total
+end program main
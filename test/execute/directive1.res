@@ -0,0 +1,4 @@
+3000
+400
+1001000
+1001000
@@ -0,0 +1,18 @@
+program main
+  integer i,n,s,cnt
+  cnt=0
+  do i=5,1
+     cnt = cnt+1
+  end do
+  print *,cnt
+  print *,i
+  do i=10,1,0-3
+     print *,i
+  end do
+  n=7
+  s=0-2
+  do i=n,2,s
+     print *,i
+  end do
+  print *,i
+end program main
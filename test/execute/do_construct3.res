@@ -0,0 +1,10 @@
+0
+5
+10
+7
+4
+1
+7
+5
+3
+1
@@ -0,0 +1,39 @@
+program main
+  integer i,j,k,n,s,t
+  integer a
+  dimension a(100)
+  n = 100
+  a = 0
+  do k=1,3
+     do i=k,n,k
+        a(i) = a(i) + k
+     end do
+  end do
+  s = 0
+  do i=1,n
+     s = s + a(i)
+  end do
+  print *,s
+  t = 0
+  k = 0-2
+  do i=n,1,k
+     t = t + a(i)
+  end do
+  print *,t
+  print *,i
+  k = 1
+  do i=i,n,k
+     t = t + 1
+  end do
+  print *,t
+  print *,i
+  ! nested loops with a stride known at run time, only the inner one is versioned
+  k = 2
+  t = 0
+  do j=1,9,k
+     do i=j,n,k
+        t = t + a(i)
+     end do
+  end do
+  print *,t
+end program main
@@ -0,0 +1,6 @@
+299
+198
+0
+299
+101
+486
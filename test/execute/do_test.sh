@@ -1,14 +1,26 @@
 #!/bin/bash
 
+# the output of a.out, with the runtime errors and the exit status when it fails
+run() {
+    ./a.out 2>&1
+    local status=$?
+    ((status != 0)) && echo "exit status $status"
+}
+
 OK=0
 NG=0
+for opt in -O0 -O2
+do
 for file in *.f90
 do
-    echo -n "$file: "
-    ../../sfc -L ../../runtime $file 
+    # options of the test, like -fcheck=bounds, are in name.opt
+    test_opt=""
+    [ -f ${file/.f90/.opt} ] && test_opt=$(cat ${file/.f90/.opt})
+    echo -n "$file ($opt $test_opt): "
+    ../../sfc $opt $test_opt -L ../../runtime $file 
     if (($? == 0 )); then
 	    # compilation is succeeded
-        if diff <(./a.out) ${file/.f90/.res}; then
+        if diff <(run) ${file/.f90/.res}; then
 	        ((OK++))
 	        echo OK
         else
@@ -22,6 +34,7 @@ do
 	    echo NG
     fi
 done
+done
 
 
 ((NG > 0)) && exit 1
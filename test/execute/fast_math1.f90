@@ -0,0 +1,21 @@
+program main
+  integer i
+  real s, t, x, y
+  dimension x(1000), y(1000)
+  do i=1,1000
+     x(i) = i
+     y(i) = 2.0
+  end do
+  ! the sums are exact, so reassociating them gives the same values
+  s = 0.0
+  t = 0.0
+  do i=1,1000
+     s = s + x(i)
+     t = t + x(i)*y(i) - 1.0
+  end do
+  print *, s, t
+  y = 3.0 - x*y
+  print *, y(1), y(1000)
+  y = x / 4.0
+  print *, y(2), y(1000)
+end program main
@@ -0,0 +1,6 @@
+500500.000000
+1000000.000000
+1.000000
+-1997.000000
+0.500000
+250.000000
@@ -0,0 +1,24 @@
+program main
+  integer i
+  real a, b, c, x, y, z, w
+  dimension x(8), y(8), z(8), w(8)
+  a = 3.0
+  b = 4.0
+  c = 5.0
+  a = a + 0.0
+  ! a*b+c, a*b-c and c-a*b become multiply-adds with the signs of the operation
+  print *, a*b+c, a*b-c, c-a*b, c+a*b
+  do i=1,8
+     x(i) = i
+     y(i) = 2.0
+     z(i) = 0.5 * i
+  end do
+  w = x*y - z
+  print *, w(1), w(8)
+  w = z - x*y
+  print *, w(1), w(8)
+  w(2:8:2) = z(2:8:2) - x(1:4)*y(1:4)
+  print *, w(2), w(8)
+  w(1:7:2) = x(1:7:2)*y(1:7:2) + z(1:7:2)
+  print *, w(1), w(7)
+end program main
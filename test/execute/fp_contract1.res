@@ -0,0 +1,12 @@
+17.000000
+7.000000
+-7.000000
+17.000000
+1.500000
+12.000000
+-1.500000
+-12.000000
+-1.000000
+-4.000000
+2.500000
+17.500000
@@ -0,0 +1,39 @@
+program main
+  integer i,j,n
+  integer a,b,c,d
+  dimension a(100), b(100), c(100), d(20,30)
+  n = 100
+  do i=1,n
+     a(i) = i * 3
+  end do
+  do i=1,n
+     b(i) = a(i) + 1
+  end do
+  do i=1,n
+     c(i) = a(i) + b(i)
+  end do
+  do i=1,99
+     a(i) = i
+  end do
+  do i=1,99
+     b(i) = a(i+1) * 2
+  end do
+  do j=1,30
+     do i=1,20
+        d(i,j) = i + j
+     end do
+  end do
+  do j=1,30
+     do i=1,20
+        d(i,j) = d(i,j) * 2
+     end do
+  end do
+  print *,c(1)
+  print *,c(100)
+  print *,b(98)
+  print *,b(99)
+  print *,d(20,30)
+  print *,d(1,2)
+  print *,i
+  print *,j
+end program main
@@ -0,0 +1,8 @@
+7
+601
+198
+600
+100
+6
+21
+31
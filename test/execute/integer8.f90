@@ -0,0 +1,18 @@
+program main
+  integer(8) i,n,big
+  integer j,a
+  dimension a(3)
+  big = 3000000000
+  print *,big
+  n = 3
+  do i=1,n
+     a(i) = i*2
+  end do
+  j = 0
+  do i=n,1,0-1
+     j = j + a(i)
+  end do
+  print *,j
+  print *,i
+  print *,big*2+j
+end program main
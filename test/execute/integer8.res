@@ -0,0 +1,4 @@
+3000000000
+12
+0
+6000000012
@@ -0,0 +1,38 @@
+program main
+  integer i,j,k,a,b,c,s
+  dimension a(300,200), b(300,200), c(20,30,40)
+  do i=1,300
+     do j=1,200
+        a(i,j) = i + j*1000
+     end do
+  end do
+  do i=1,300
+     do j=1,200
+        b(i,j) = a(i,j) * 2
+     end do
+  end do
+  do i=2,300
+     do j=1,199
+        a(i,j) = a(i-1,j+1) + 1
+     end do
+  end do
+  do k=1,20
+     do j=1,30
+        do i=1,40
+           c(k,j,i) = k + j*100 + i*10000
+        end do
+     end do
+  end do
+  s = 0
+  do i=1,300
+     do j=1,200
+        s = s + b(i,j) / 1000
+     end do
+  end do
+  print *,a(300,1)
+  print *,a(2,199)
+  print *,b(300,200)
+  print *,c(20,30,40)
+  print *,c(3,2,1)
+  print *,s
+end program main
@@ -0,0 +1,6 @@
+200300
+200002
+400600
+403020
+10203
+12060000
@@ -0,0 +1,41 @@
+program main
+  integer i, j, a, b, d
+  real x, y
+  dimension a(64,3), b(64,3), d(128,2), x(64,4), y(64,4)
+  data (d(i,2), i=1,128,2) /64*4/, d(128,1) /9/
+  ! fill, copy and elementwise assignment of the columns only
+  a = 0
+  b = 7
+  do j=1,3
+     do i=1,64
+        a(i,j) = i + j
+     end do
+  end do
+  b = a
+  x = 1.5
+  y = x * 2.0
+  print *, b(1,1), b(64,1), b(1,3), b(64,3)
+  print *, x(64,1), y(1,4), y(64,4)
+  a = a + b
+  print *, a(1,1), a(64,2), total(a)
+  print *, d(1,2), d(2,2), d(127,2), d(128,1), d(1,1)
+  ! a padded array is passed as a whole to a dummy of the same shape
+  call scale(a)
+  print *, a(2,1), a(64,3), total(a)
+contains
+  integer function total(m)
+    integer m, k, l
+    dimension m(64,3)
+    total = 0
+    do l=1,3
+       do k=1,64
+          total = total + m(k,l)
+       end do
+    end do
+  end function total
+  subroutine scale(m)
+    integer m
+    dimension m(64,3)
+    m = m * 3
+  end subroutine scale
+end program main
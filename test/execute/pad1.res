@@ -0,0 +1,18 @@
+2
+65
+4
+67
+1.500000
+3.000000
+3.000000
+4
+132
+13248
+4
+0
+4
+9
+0
+18
+402
+39744
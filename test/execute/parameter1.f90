@@ -0,0 +1,20 @@
+program main
+  integer, parameter :: n = 100, m = n/2
+  integer(kind=8), parameter :: big = 5000000000
+  real, parameter :: half = 1/2.0, scale = n
+  logical, parameter :: debug = .false.
+  character(5), parameter :: greeting = "hello"
+  integer k, i, a
+  real x
+  parameter (k = m + 3)
+  dimension a(n, m)
+  a = 1
+  x = 0.0
+  do i=1,k
+     a(i, 1) = i
+  end do
+  print *, a(n, 1), a(n, m), k
+  print *, half, scale, big
+  print *, debug, greeting
+  print *, n * m
+end program main
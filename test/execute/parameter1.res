@@ -0,0 +1,9 @@
+1
+1
+53
+0.500000
+100.000000
+5000000000
+F
+hello
+5000
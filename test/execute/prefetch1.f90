@@ -0,0 +1,36 @@
+program main
+  integer i, j, n, k
+  real a, b, c, s
+  dimension a(4096), b(64,100), c(2000)
+  n = 4096
+  do i=1,n
+     a(i) = i
+  end do
+  do j=1,100
+     do i=1,64
+        b(i,j) = i + j
+     end do
+  end do
+  ! 32 elements, 128 bytes, per iteration
+  s = 0.0
+  do i=1,n,32
+     s = s + a(i)
+  end do
+  print *, s
+  ! a row of b, 256 bytes per iteration, the prefetches run past the last column
+  k = 3
+  s = 0.0
+  do j=1,100
+     s = s + b(k,j)
+  end do
+  print *, s
+  ! unit stride over c, larger than -fllc-size=
+  do i=1,2000
+     c(i) = a(i) * 2.0
+  end do
+  s = 0.0
+  do i=1,2000
+     s = s + c(i)
+  end do
+  print *, s
+end program main
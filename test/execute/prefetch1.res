@@ -0,0 +1,3 @@
+260224.000000
+5350.000000
+4002000.000000
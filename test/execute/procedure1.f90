@@ -0,0 +1,96 @@
+program main
+  integer i, n, a, b, s
+  real x, y
+  dimension a(10), b(3,4), x(8), y(8)
+  n = 3
+  ! n is defined by the call, so it is not folded
+  call set_value(n, 5)
+  print *, n
+  do i=1,10
+     a(i) = i
+  end do
+  call double(a(1:3))
+  print *, a(1), a(3), a(4)
+  ! element sequence association of an element
+  call double(a(8))
+  print *, a(7), a(8), a(10)
+  b = 1
+  call double(b(1:3,2))
+  call double(b(1,4))
+  print *, sum_of(b)
+  do i=1,8
+     x(i) = i
+     y(i) = 1.0
+  end do
+  ! a small procedure called in a loop
+  do i=1,8
+     call axpy(2.0, x(i), y(i))
+  end do
+  print *, y(1), y(8)
+  s = 0
+  do i=1,4
+     s = s + square(i)
+  end do
+  print *, s, scale(x(8))
+  call accumulate(10)
+  print *, n
+  ! whole dummy arrays associated with elements in the middle of a
+  call clear(a(2))
+  print *, a(1), a(2), a(5), a(6)
+  call copy(a(3), a(7))
+  print *, a(3), a(6)
+contains
+  subroutine double(v)
+    integer v, j
+    dimension v(3)
+    do j=1,3
+       v(j) = v(j) * 2
+    end do
+  end subroutine double
+  integer function square(k)
+    integer k
+    square = k * k
+  end function square
+  real function scale(t) result(r)
+    real t
+    r = t * n
+    return
+  end function scale
+  integer function sum_of(m)
+    integer m, j, k
+    dimension m(3,4)
+    sum_of = 0
+    do k=1,4
+       do j=1,3
+          sum_of = sum_of + m(j,k) * k
+       end do
+    end do
+  end function sum_of
+  subroutine accumulate(k)
+    integer k
+    ! n is the variable of the host
+    n = n + k
+  end subroutine accumulate
+  subroutine clear(v)
+    integer v
+    dimension v(4)
+    v = 0
+  end subroutine clear
+  subroutine copy(u, v)
+    integer u, v
+    dimension u(4), v(4)
+    u = v
+  end subroutine copy
+end program main
+
+subroutine set_value(v, k)
+  integer v, k
+  v = k
+  if (k > 0) return
+  v = 0
+end subroutine set_value
+
+subroutine axpy(a, x, y)
+  real a, x, y
+  y = y + a * x
+end subroutine axpy
@@ -0,0 +1,19 @@
+5
+2
+6
+4
+7
+16
+20
+48
+3.000000
+17.000000
+30
+40.000000
+15
+2
+0
+0
+6
+7
+20
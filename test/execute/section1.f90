@@ -0,0 +1,42 @@
+program main
+  integer i, j, n, a, b, c
+  real x, y
+  dimension a(10), b(10), c(4,5), x(8), y(8)
+  n = 10
+  do i=1,10
+     a(i) = i
+  end do
+  b = 0
+  b(1:n:2) = a(2:n:2)
+  print *, b(1), b(3), b(9), b(2)
+  ! overlapping shift: the right-hand side is read before a is defined
+  a(2:n) = a(1:n-1)
+  print *, a(1), a(2), a(10)
+  a(1:n-1) = a(2:n)
+  print *, a(1), a(9), a(10)
+  a(n:1:-1) = b
+  print *, a(1), a(2), a(10)
+  a(:5) = 7
+  a(6:) = a(:5) + 1
+  print *, a(1), a(6), a(10)
+  do j=1,5
+     do i=1,4
+        c(i,j) = 10*i + j
+     end do
+  end do
+  b(3:6) = c(:, 3)
+  print *, b(3), b(6)
+  b(1:5) = c(2, :)
+  print *, b(1), b(5)
+  c(2:3, 2:4) = c(1:2, 1:3) * 2
+  print *, c(2,2), c(3,4), c(1,1)
+  x = 1.5
+  y = 2.0
+  x(2:7) = x(1:6) + y(3:8) * 2.0
+  print *, x(1), x(2), x(8)
+  a(5:4) = 99
+  print *, a(4), a(5)
+  j = 3
+  a(j:j+2) = b(1:3)
+  print *, a(3), a(5)
+end program main
@@ -0,0 +1,30 @@
+2
+4
+10
+0
+1
+1
+9
+1
+9
+9
+0
+10
+2
+7
+8
+8
+13
+43
+21
+25
+22
+46
+11
+1.500000
+5.500000
+1.500000
+7
+7
+21
+23
@@ -0,0 +1,38 @@
+program main
+  integer i,j,k,s
+  integer a,b,c
+  dimension a(300,250), b(250,300), c(0:40,0:30)
+  do j=1,250
+     do i=1,300
+        a(i,j) = i + j*1000
+     end do
+  end do
+  do j=1,300
+     do i=1,250
+        b(i,j) = a(j,i) * 2
+     end do
+  end do
+  ! tile sizes given by directives
+  c = 0
+  !dir$ block(7)
+  do j=30,1,0-2
+     !DIR$ BLOCK(5)
+     do i=0,40,3
+        c(i,j) = i + j*100
+     end do
+  end do
+  s = 0
+  do j=1,300
+     do i=1,250
+        s = s + b(i,j) / 1000
+     end do
+  end do
+  print *,b(250,300)
+  print *,b(17,299)
+  print *,c(39,2)
+  print *,c(39,1)
+  print *,c(0,30)
+  print *,i
+  print *,j
+  print *,s
+end program main
@@ -0,0 +1,8 @@
+500600
+34598
+239
+0
+3000
+251
+301
+18825000
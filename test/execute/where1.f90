@@ -0,0 +1,33 @@
+program main
+  integer i, a, b, c, n
+  real x, y
+  logical m
+  dimension a(10), b(10), c(10), x(10), y(10), m(10)
+  do i=1,10
+     a(i) = i - 5
+     b(i) = i
+     x(i) = i
+  end do
+  n = 7
+  c = 100
+  ! no division by zero where a is 0
+  where (a /= 0) c = n / a
+  print *, c(4), c(5), c(6), c(10)
+  m = a > 2
+  where (m)
+     y = x * 2.0
+     b = b + a
+  elsewhere (a < 0)
+     y = 0.0 - x
+  elsewhere
+     y = 0.5
+     b = 0
+  end where
+  print *, y(1), y(5), y(6), y(8), y(10)
+  print *, b(1), b(5), b(6), b(8)
+  ! a(1) is read after a is defined, so it goes through temporaries
+  where (a > 0) a = a + a(10)
+  print *, a(1), a(6), a(10)
+  where (b > 3) b = b(10) - b
+  print *, b(1), b(8), b(10)
+end program main
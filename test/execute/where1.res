@@ -0,0 +1,19 @@
+-7
+100
+7
+1
+-1.000000
+0.500000
+0.500000
+16.000000
+20.000000
+1
+0
+0
+11
+-4
+6
+10
+1
+4
+0